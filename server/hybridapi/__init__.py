@@ -74,10 +74,25 @@ def create_app(config_name: str = 'default'):
                 raise Exception(f"In {simulation_config_full_path}, sim2dut declares labels and numbers with different size")
     app.config['SIMULATION_CONFIG']['messages']['web2sim'].setdefault('file', "input-messages.txt")
     app.config['SIMULATION_CONFIG']['messages']['sim2web'].setdefault('file', "output-messages.txt")
+    # "files" (default), "socket" or "shm" (if the simulation runs with the "socket" or "shm" configuration)
+    app.config['SIMULATION_CONFIG']['messages'].setdefault('transport', "files")
+    app.config['SIMULATION_CONFIG']['messages'].setdefault('socket', "hybridapi.sock")
+    app.config['SIMULATION_CONFIG']['messages'].setdefault('shm', "/dev/shm/hybridapi")
 
     if not app.config['SIMULATION_CONFIG'].get('iframe'):
         raise Exception("iframe is mandatory in any simulation .yml file") 
 
+    transport = app.config['SIMULATION_CONFIG']['messages']['transport']
+    if transport == 'socket':
+        from .bridge import SocketBridge
+        socket_path = os.path.join(app.config['BINARY_DIRECTORY'], app.config['SIMULATION_CONFIG']['messages']['socket'])
+        app.extensions['simulation_bridge'] = SocketBridge(socket_path).start()
+    elif transport == 'shm':
+        from .bridge import SharedMemoryBridge
+        app.extensions['simulation_bridge'] = SharedMemoryBridge(app.config['SIMULATION_CONFIG']['messages']['shm'])
+    elif transport != 'files':
+        raise Exception(f"In {simulation_config_full_path}, unsupported messages transport: {transport}")
+
     # Register views
     from .views.main import main_blueprint
 
@@ -0,0 +1,240 @@
+#
+# Copyright (C) 2023 onwards LabsLand, Inc.
+# All rights reserved.
+#
+# This software is licensed as described in the file LICENSE, which
+# you should have received as part of this distribution.
+#
+
+import os
+import mmap
+import time
+import socket
+import struct
+import threading
+from logging import getLogger
+from typing import Optional, Tuple
+
+logger = getLogger(__name__)
+
+MAX_MESSAGE_SIZE = 64 * 1024
+
+class SocketBridge:
+    """
+    Connects to a simulation running with the "socket" configuration, which listens in
+    a SOCK_SEQPACKET Unix socket. Reports are pushed by the simulation as soon as they
+    are sent, so the views waiting for a new report are woken up straight away instead
+    of polling. web2sim messages are sent as one packet each.
+    """
+
+    ACKNOWLEDGEMENT = b'\0'
+
+    def __init__(self, socket_path: str):
+        self.socket_path = socket_path
+        self._condition = threading.Condition()
+        self._socket: Optional[socket.socket] = None
+        self._report = ''
+        self._sequence = 0
+        self._last_request = ''
+
+    def start(self) -> 'SocketBridge':
+        thread = threading.Thread(target=self._run, name="simulation-socket-bridge", daemon=True)
+        thread.start()
+        return self
+
+    def _run(self):
+        while True:
+            sock = socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+            try:
+                sock.connect(self.socket_path)
+            except OSError:
+                sock.close()
+                time.sleep(0.5)
+                continue
+
+            logger.info(f"Connected to the simulation in {self.socket_path}")
+            with self._condition:
+                self._socket = sock
+
+            try:
+                while True:
+                    data = sock.recv(MAX_MESSAGE_SIZE)
+                    if not data:
+                        break
+                    with self._condition:
+                        self._report = data.decode('utf-8', errors='replace').strip()
+                        self._sequence += 1
+                        self._condition.notify_all()
+            except OSError as error:
+                logger.warning(f"Connection with the simulation lost: {error}")
+            finally:
+                with self._condition:
+                    self._socket = None
+                sock.close()
+
+    def latest_report(self) -> Tuple[int, str]:
+        with self._condition:
+            return self._sequence, self._report
+
+    def wait_for_report(self, previous_report: str, timeout: float) -> Tuple[int, str]:
+        """
+        Wait at most timeout seconds until the report is different from previous_report.
+        """
+        with self._condition:
+            self._condition.wait_for(lambda: self._report != previous_report, timeout=max(timeout, 0))
+            return self._sequence, self._report
+
+    def send_request(self, value: str) -> bool:
+        with self._condition:
+            sock = self._socket
+            self._last_request = value
+        if sock is None:
+            return False
+        try:
+            sock.send(value.encode('utf-8'))
+        except OSError as error:
+            logger.warning(f"Could not send message to the simulation: {error}")
+            return False
+        return True
+
+    def acknowledge_report(self):
+        """
+        Tell the simulation that a report was read, with a packet starting with a NUL byte.
+        """
+        with self._condition:
+            sock = self._socket
+        if sock is None:
+            return
+        try:
+            sock.send(self.ACKNOWLEDGEMENT)
+        except OSError:
+            pass
+
+    def last_request(self) -> str:
+        with self._condition:
+            return self._last_request
+
+
+class SharedMemoryBridge:
+    """
+    Connects to a simulation running with the "shm" configuration, which publishes its
+    reports in a triple buffer in shared memory and reads requests from a ring in the
+    same mapping (see communicatorsharedmemory.h for the layout). Nothing is locked:
+    reports are validated with the per-slot sequence and retried if they were being
+    overwritten meanwhile.
+    """
+
+    MAGIC = 0x4d534c4c
+    VERSION = 1
+    HEADER_SIZE = 64
+    REPORT_SLOTS = 3
+    REPORT_SLOT_HEADER_SIZE = 16
+    REQUEST_SLOT_HEADER_SIZE = 8
+    ACKNOWLEDGEMENTS_OFFSET = 40
+    POLLING_PERIOD = 0.005
+
+    def __init__(self, shm_path: str):
+        self.shm_path = shm_path
+        self._lock = threading.Lock()
+        self._mapping: Optional[mmap.mmap] = None
+        self._inode = None
+        self._last_request = ''
+
+    def _open(self) -> Optional[mmap.mmap]:
+        """
+        Return the mapping, (re)opening it if the simulation (re)created it.
+        """
+        try:
+            inode = os.stat(self.shm_path).st_ino
+        except OSError:
+            self._mapping = None
+            return None
+
+        if self._mapping is not None and inode == self._inode:
+            return self._mapping
+
+        try:
+            with open(self.shm_path, 'r+b') as shm_file:
+                mapping = mmap.mmap(shm_file.fileno(), 0)
+        except (OSError, ValueError):
+            return None
+
+        magic, version = struct.unpack_from('<II', mapping, 0)
+        if magic != self.MAGIC or version != self.VERSION:
+            mapping.close()
+            return None
+
+        self._mapping = mapping
+        self._inode = inode
+        return mapping
+
+    def latest_report(self) -> Tuple[int, str]:
+        with self._lock:
+            mapping = self._open()
+            if mapping is None:
+                return 0, ''
+
+            report_slot_size, = struct.unpack_from('<I', mapping, 8)
+            while True:
+                latest, = struct.unpack_from('<I', mapping, 20)
+                sequence, = struct.unpack_from('<Q', mapping, 24)
+                if latest >= self.REPORT_SLOTS:
+                    return 0, ''
+
+                offset = self.HEADER_SIZE + latest * (self.REPORT_SLOT_HEADER_SIZE + report_slot_size)
+                slot_sequence, size = struct.unpack_from('<QI', mapping, offset)
+                if slot_sequence % 2:
+                    continue
+                size = min(size, report_slot_size)
+                data_offset = offset + self.REPORT_SLOT_HEADER_SIZE
+                data = mapping[data_offset:data_offset + size]
+                if struct.unpack_from('<Q', mapping, offset)[0] == slot_sequence:
+                    return sequence, data.decode('utf-8', errors='replace').strip()
+
+    def wait_for_report(self, previous_report: str, timeout: float) -> Tuple[int, str]:
+        """
+        Wait at most timeout seconds until the report is different from previous_report.
+        """
+        deadline = time.time() + max(timeout, 0)
+        while True:
+            sequence, report = self.latest_report()
+            if report != previous_report or time.time() >= deadline:
+                return sequence, report
+            time.sleep(self.POLLING_PERIOD)
+
+    def send_request(self, value: str) -> bool:
+        payload = value.encode('utf-8')
+        with self._lock:
+            self._last_request = value
+            mapping = self._open()
+            if mapping is None:
+                return False
+
+            report_slot_size, request_slot_size, request_slots = struct.unpack_from('<III', mapping, 8)
+            head, tail = struct.unpack_from('<II', mapping, 32)
+            if len(payload) > request_slot_size or (head - tail) % 2**32 >= request_slots:
+                return False
+
+            offset = (self.HEADER_SIZE + self.REPORT_SLOTS * (self.REPORT_SLOT_HEADER_SIZE + report_slot_size)
+                      + (head % request_slots) * (self.REQUEST_SLOT_HEADER_SIZE + request_slot_size))
+            data_offset = offset + self.REQUEST_SLOT_HEADER_SIZE
+            mapping[data_offset:data_offset + len(payload)] = payload
+            struct.pack_into('<I', mapping, offset, len(payload))
+            struct.pack_into('<I', mapping, 32, (head + 1) % 2**32)
+            return True
+
+    def acknowledge_report(self):
+        """
+        Bump the acknowledgements counter of the header, which tells the simulation that
+        a report was read. Only this process writes it, under self._lock.
+        """
+        with self._lock:
+            mapping = self._open()
+            if mapping is None:
+                return
+            acknowledgements, = struct.unpack_from('<Q', mapping, self.ACKNOWLEDGEMENTS_OFFSET)
+            struct.pack_into('<Q', mapping, self.ACKNOWLEDGEMENTS_OFFSET, (acknowledgements + 1) % 2**64)
+
+    def last_request(self) -> str:
+        with self._lock:
+            return self._last_request
@@ -8,6 +8,7 @@
 
 import os
 import time
+import fcntl
 from logging import getLogger
 from typing import Optional
 from functools import wraps
@@ -180,21 +181,88 @@ def gpios_dut2sim(number: Optional[int]):
 
     return jsonify(success=True)
 
+def read_sim2web_report(sim2web_messages: str):
+    """
+    Read the last report published by the simulation. The simulation publishes
+    reports atomically as "<sequence>\n<report>". Return (sequence, report), where
+    sequence is None if the file does not exist or has no sequence header.
+    """
+    if not os.path.exists(sim2web_messages):
+        return None, ''
+
+    content = open(sim2web_messages).read()
+    header, separator, report = content.partition('\n')
+    if separator and header.isdigit():
+        return int(header), report.strip()
+
+    return None, content.strip()
+
+
+def acknowledge_sim2web_report(sim2web_messages: str):
+    """
+    Bump the counter in "<file>.ack", which tells the simulation that somebody is
+    reading its reports (so it may report more often while its state changes).
+    """
+    with open(sim2web_messages + '.ack', 'a+') as ack_file:
+        fcntl.flock(ack_file, fcntl.LOCK_EX)
+        try:
+            ack_file.seek(0)
+            content = ack_file.read().strip()
+            counter = int(content) if content.isdigit() else 0
+            ack_file.seek(0)
+            ack_file.truncate()
+            ack_file.write(str(counter + 1))
+            ack_file.flush()
+        finally:
+            fcntl.flock(ack_file, fcntl.LOCK_UN)
+
+
 @main_blueprint.route('/api/messages/sim2web/')
 @supports_long_polling
 def messages_sim2web():
+    bridge = current_app.extensions.get('simulation_bridge')
+    if bridge is not None:
+        if g.wait_for_response is None:
+            sequence, value = bridge.latest_report()
+        else:
+            remaining = g.wait_for_response - (time.time() - g.long_polling_initial_time)
+            sequence, value = bridge.wait_for_report(g.previous_response, remaining)
+        bridge.acknowledge_report()
+        return jsonify(success=True, value=value, sequence=sequence)
+
     binary_dir = current_app.config['BINARY_DIRECTORY']
     sim2web_messages = os.path.join(binary_dir, current_app.config['SIMULATION_CONFIG']['messages']['sim2web']['file'])
     while True:
-        if os.path.exists(sim2web_messages):
-            value = open(sim2web_messages).read().strip()
-        else:
-            value = ''
+        sequence, value = read_sim2web_report(sim2web_messages)
 
         if check_long_polling(value):
             continue
 
-        return jsonify(success=True, value=value)
+        acknowledge_sim2web_report(sim2web_messages)
+        return jsonify(success=True, value=value, sequence=sequence)
+
+
+def append_web2sim_message(web2sim_messages: str, value: str):
+    """
+    Append a message to the web2sim log read by the simulation. Messages are stored
+    one after the other as "<length>:<message>" (length in bytes), and the simulation
+    truncates the log once it has consumed all of them, holding the same lock.
+
+    The last message sent is also kept in "<file>.last" to show it in the interface.
+    """
+    payload = value.encode('utf-8')
+    with open(web2sim_messages, 'ab') as web2sim_messages_file:
+        fcntl.flock(web2sim_messages_file, fcntl.LOCK_EX)
+        try:
+            web2sim_messages_file.write(str(len(payload)).encode('ascii') + b':' + payload)
+            web2sim_messages_file.flush()
+        finally:
+            fcntl.flock(web2sim_messages_file, fcntl.LOCK_UN)
+
+    last_message_tmp = web2sim_messages + '.last.tmp'
+    with open(last_message_tmp, 'w') as last_message_file:
+        last_message_file.write(value)
+    os.replace(last_message_tmp, web2sim_messages + '.last')
 
 
 @main_blueprint.route('/api/messages/web2sim/', methods=['GET', 'POST'])
@@ -202,10 +270,19 @@ def messages_sim2web():
 def messages_web2sim():
     binary_dir = current_app.config['BINARY_DIRECTORY']
     web2sim_messages = os.path.join(binary_dir, current_app.config['SIMULATION_CONFIG']['messages']['web2sim']['file'])
+    bridge = current_app.extensions.get('simulation_bridge')
     if request.method == 'GET':
+        if bridge is not None:
+            while True:
+                value = bridge.last_request()
+                if check_long_polling(value):
+                    continue
+                return jsonify(success=True, value=value)
+
+        web2sim_last_message = web2sim_messages + '.last'
         while True:
-            if os.path.exists(web2sim_messages):
-                value = open(web2sim_messages).read()
+            if os.path.exists(web2sim_last_message):
+                value = open(web2sim_last_message).read()
             else:
                 value = ""
 
@@ -214,20 +291,16 @@ def messages_web2sim():
 
             return jsonify(success=True, value=value)
 
-    if os.path.exists(web2sim_messages):
-        mode = 'r+'
-    else:
-        mode = 'w'
-
     request_data = request.get_json(silent=True, force=True) or {}
     value = request_data.get('value')
     if value is None:
         return jsonify(success=False, message="Invalid 'value' provided in json"), 400
 
-    with open(web2sim_messages, mode) as web2sim_messages_file:
-        web2sim_messages_file.seek(0)
-        web2sim_messages_file.write(value)
-        web2sim_messages_file.truncate(len(value))
-        web2sim_messages_file.flush()
+    if bridge is not None:
+        if not bridge.send_request(value):
+            return jsonify(success=False, message="The simulation is not connected"), 503
+        return jsonify(success=True)
+
+    append_web2sim_message(web2sim_messages, value)
 
     return jsonify(success=True)
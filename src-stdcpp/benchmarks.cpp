@@ -0,0 +1,1058 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include "benchmarks.h"
+#include "labsland/simulations/simulation.h"
+#include "labsland/simulations/utils/communicatorfiles.h"
+#include "labsland/simulations/utils/communicatorsocket.h"
+#include "labsland/simulations/utils/communicatorsharedmemory.h"
+#include "labsland/simulations/utils/communicatorasync.h"
+#include "labsland/utils/timemanagerstd.h"
+#include "labsland/utils/timerwheel.h"
+#include "labsland/simulations/watertanksimulation.h"
+#include "deusto/watertankDeusto.h"
+#include "rhlab/butterfly.h"
+#include "rhlab/matrix.h"
+#include "rhlab/morse.h"
+#include "labsland/protocols/i2ciowrapperfiles.h"
+#include "labsland/protocols/spiiowrapperfiles.h"
+#include "labsland/protocols/i2cdevices.h"
+
+using namespace std;
+using namespace LabsLand::Simulations::Utils;
+
+namespace {
+
+    typedef chrono::steady_clock BenchmarkClock;
+
+    /*
+     * Report used by the communicator benchmarks: a counter (so every report differs)
+     * padded to a size similar to the one of the simulations' reports.
+     */
+    struct BenchmarkReport : public BaseOutputDataType {
+        uint64_t counter = 0;
+
+        std::string serialize() const {
+            std::string result = to_string(counter) + "&";
+            result.resize(64, '0');
+            return result;
+        }
+    };
+
+    struct BenchmarkRequest : public BaseInputDataType {
+        bool deserialize(std::string const & input) {
+            return true;
+        }
+    };
+
+    void printLatencies(const string & name, vector<double> latenciesUs) {
+        if (latenciesUs.empty()) {
+            cout << name << ": no samples" << endl;
+            return;
+        }
+        sort(latenciesUs.begin(), latenciesUs.end());
+        double total = 0;
+        for (double latency : latenciesUs)
+            total += latency;
+
+        cout << name << ": " << latenciesUs.size() << " samples; latency (us)"
+             << " mean=" << total / latenciesUs.size()
+             << " p50=" << latenciesUs[latenciesUs.size() / 2]
+             << " p99=" << latenciesUs[latenciesUs.size() * 99 / 100]
+             << " max=" << latenciesUs.back() << endl;
+    }
+
+    double elapsedUs(BenchmarkClock::time_point since) {
+        return chrono::duration<double, micro>(BenchmarkClock::now() - since).count();
+    }
+
+    /*
+     * Time since sendReport() is called until a reader can see the report, with the files,
+     * socket and shared memory communicators. The files and shared memory readers poll without
+     * sleeping (the web server adds its own polling period on top of this).
+     */
+    int benchmarkCommunicators() {
+        const int reports = 2000;
+        BenchmarkReport report;
+
+        {
+            const string outputFilename = "bench-output-messages.txt";
+            const string inputFilename = "bench-input-messages.txt";
+            remove(outputFilename.c_str());
+
+            vector<double> latencies;
+            {
+                SimulationCommunicatorFiles<BenchmarkReport, BenchmarkRequest> communicator(outputFilename, inputFilename);
+                for (int i = 0; i < reports; i++) {
+                    report.counter++;
+                    auto start = BenchmarkClock::now();
+                    communicator.sendReport(report);
+                    uint64_t expectedSequence = communicator.getReportSequence();
+                    while (true) {
+                        ifstream ifile(outputFilename);
+                        uint64_t sequence = 0;
+                        if ((ifile >> sequence) && sequence >= expectedSequence)
+                            break;
+                    }
+                    latencies.push_back(elapsedUs(start));
+                }
+            }
+            printLatencies("files", latencies);
+            remove(outputFilename.c_str());
+            remove((inputFilename + ".offset").c_str());
+        }
+
+        {
+            const string socketPath = "bench-hybridapi.sock";
+            vector<double> latencies;
+            SimulationCommunicatorSocket<BenchmarkReport, BenchmarkRequest> communicator(socketPath);
+            SimulationCommunicatorSocketPeer peer;
+            if (!peer.connectTo(socketPath)) {
+                cerr << "Could not connect to " << socketPath << endl;
+                return 1;
+            }
+
+            string received;
+            for (int i = 0; i < reports; i++) {
+                report.counter++;
+                auto start = BenchmarkClock::now();
+                communicator.sendReport(report);
+                if (!peer.receiveReport(received, 1000)) {
+                    cerr << "Report " << i << " not received through the socket" << endl;
+                    return 1;
+                }
+                latencies.push_back(elapsedUs(start));
+            }
+            printLatencies("socket", latencies);
+        }
+
+        {
+            const string name = "/hybridapi-bench";
+            vector<double> latencies;
+            SimulationCommunicatorSharedMemory<BenchmarkReport, BenchmarkRequest> communicator(name);
+            SimulationCommunicatorSharedMemoryPeer peer;
+            if (!peer.connectTo(name)) {
+                cerr << "Could not open shared memory " << name << endl;
+                return 1;
+            }
+
+            string received;
+            uint64_t sequence = 0;
+            for (int i = 0; i < reports; i++) {
+                report.counter++;
+                auto start = BenchmarkClock::now();
+                communicator.sendReport(report);
+                uint64_t expectedSequence = communicator.getReportSequence();
+                while (!peer.readLatestReport(received, &sequence) || sequence < expectedSequence) {}
+                latencies.push_back(elapsedUs(start));
+            }
+            printLatencies("shm", latencies);
+        }
+        return 0;
+    }
+
+    /*
+     * The stringstream serializers the data types used before having field descriptors,
+     * kept here as a reference for both the output and the speed.
+     */
+    string legacySerialize(const WatertankDeustoData & data) {
+        stringstream stream;
+        stream << data.level << "&" << data.totalVolume << "&" << data.volume << "&" << data.pump1Active << "&" << data.pump2Active << "&" <<
+            data.pump1Temperature << "&" << data.pump2Temperature << "&" << data.currentLoad << "&" << data.lowSensorActive << "&" <<
+            data.midSensorActive << "&" << data.highSensorActive << "&"<< data.pump1Hot << "&" << data.pump2Hot << "&" <<
+            data.pump1Broken << "&" << data.pump2Broken << "&";
+        return stream.str();
+    }
+
+    string legacySerialize(const ButterflyData & data) {
+        stringstream stream;
+        for(int i = 0; i < LED_ARRAY_SIZE; i++){
+            stream << "led" << i << "=" << data.virtual_led[i];
+            if(i < LED_ARRAY_SIZE - 1){
+                stream << "&";
+            }
+        }
+        return stream.str();
+    }
+
+    string legacySerialize(const RHLab::LEDMatrix::MatrixData & data) {
+        stringstream stream;
+        for (int row = 0; row < RHLab::LEDMatrix::ROWS; row++) {
+            for (int col = 0; col < RHLab::LEDMatrix::COLS; col++){
+                stream << data.leds[row * RHLab::LEDMatrix::COLS + col];
+            }
+            if(row < RHLab::LEDMatrix::ROWS - 1){
+                stream << ":";
+            }
+        }
+        return stream.str();
+    }
+
+    /*
+     * Nanoseconds per call of function, run iterations times.
+     */
+    template <class Function>
+    double measureNs(int iterations, Function function) {
+        auto start = BenchmarkClock::now();
+        for (int i = 0; i < iterations; i++)
+            function(i);
+        return chrono::duration<double, nano>(BenchmarkClock::now() - start).count() / iterations;
+    }
+
+    template <class DataType>
+    int benchmarkSerializer(const string & name, DataType & data, function<void(DataType &, int)> mutate) {
+        const int iterations = 200000;
+        char buffer[4096];
+        size_t checksum = 0;
+
+        for (int i = 0; i < 100; i++) {
+            mutate(data, i);
+            string expected = legacySerialize(data);
+            size_t length = data.serializeTo(buffer, sizeof(buffer));
+            if (data.serialize() != expected || string(buffer, length) != expected) {
+                cerr << name << ": the serialization differs from the reference one:" << endl
+                     << "    expected: " << expected << endl
+                     << "    obtained: " << string(buffer, length) << endl;
+                return 1;
+            }
+        }
+
+        double legacyNs = measureNs(iterations, [&](int i) { mutate(data, i); checksum += legacySerialize(data).size(); });
+        double serializeNs = measureNs(iterations, [&](int i) { mutate(data, i); checksum += data.serialize().size(); });
+        double serializeToNs = measureNs(iterations, [&](int i) { mutate(data, i); checksum += data.serializeTo(buffer, sizeof(buffer)); });
+        double binaryNs = measureNs(iterations, [&](int i) { mutate(data, i); checksum += data.serializeBinary(buffer, sizeof(buffer)); });
+
+        cout << name << ": ns per report"
+             << " stringstream=" << legacyNs
+             << " serialize=" << serializeNs
+             << " serializeTo=" << serializeToNs
+             << " serializeBinary=" << binaryNs
+             << " (" << data.serializeTo(buffer, sizeof(buffer)) << " bytes as text, "
+             << data.serializeBinary(buffer, sizeof(buffer)) << " as binary; checksum " << checksum % 10 << ")" << endl;
+        return 0;
+    }
+
+    /*
+     * Time to serialize the reports of some simulations with the old stringstream code and
+     * with the serializers generated from the field descriptors.
+     */
+    int benchmarkSerializers() {
+        WatertankDeustoData watertank = {};
+        int result = benchmarkSerializer<WatertankDeustoData>("watertankDeusto", watertank, [](WatertankDeustoData & data, int i) {
+            data.level = 0.001f * (i % 1000);
+            data.volume = 1.5f * (i % 700);
+            data.totalVolume = 1000;
+            data.pump1Temperature = 20 + 0.25f * (i % 300);
+            data.pump2Temperature = 20 + 0.5f * (i % 200);
+            data.currentLoad = (i % 13) * 0.75f;
+            data.pump1Active = i % 2;
+            data.pump2Active = i % 3 == 0;
+            data.highSensorActive = i % 5 == 0;
+            data.pump1Broken = i % 7 == 0;
+        });
+        if (result != 0)
+            return result;
+
+        ButterflyData butterfly = {};
+        result = benchmarkSerializer<ButterflyData>("butterfly", butterfly, [](ButterflyData & data, int i) {
+            data.virtual_led[i % LED_ARRAY_SIZE] = !data.virtual_led[i % LED_ARRAY_SIZE];
+        });
+        if (result != 0)
+            return result;
+
+        RHLab::LEDMatrix::MatrixData matrix;
+        memset(matrix.leds, '0', sizeof(matrix.leds));
+        return benchmarkSerializer<RHLab::LEDMatrix::MatrixData>("matrix", matrix, [](RHLab::LEDMatrix::MatrixData & data, int i) {
+            char & led = data.leds[i % sizeof(data.leds)];
+            led = led == '0' ? '1' : '0';
+        });
+    }
+
+    /*
+     * Time to parse a web2sim message and check its required variables with the map-based
+     * parseQueryArgs() and with QueryArgs.
+     */
+    int benchmarkQueryArgs() {
+        const int iterations = 200000;
+        static constexpr auto VARIABLES = queryVariables("speed", "clearing", "text", "led0", "led1", "led2", "led3", "led4");
+        const vector<string> required = { "speed", "clearing", "led0", "led4" };
+        const uint64_t requiredMask = VARIABLES.maskOf("speed") | VARIABLES.maskOf("clearing") | VARIABLES.maskOf("led0") | VARIABLES.maskOf("led4");
+        const string input = "speed=normal&clearing&text=hello&led0=1&led1=0&led2=1&led3=0&led4=1";
+
+        BenchmarkRequest request;
+        QueryArgs<> args;
+        size_t found = 0;
+
+        auto map = request.parseQueryArgs(input);
+        if (!request.parseQueryArgs(input, args, VARIABLES) || args.size() != map.size() || !args.hasAll(requiredMask)) {
+            cerr << "QueryArgs does not match the map-based parser" << endl;
+            return 1;
+        }
+        for (const auto & variable : map) {
+            if (args.get(variable.first) != variable.second) {
+                cerr << "QueryArgs does not match the map-based parser for " << variable.first << endl;
+                return 1;
+            }
+        }
+
+        double mapNs = measureNs(iterations, [&](int) {
+            auto parsed = request.parseQueryArgs(input);
+            found += request.checkVariablesInArgs(parsed, required) ? parsed["speed"].size() : 0;
+        });
+        double flatNs = measureNs(iterations, [&](int) {
+            request.parseQueryArgs(input, args, VARIABLES);
+            found += request.checkVariablesInArgs(args, requiredMask) ? args.get("speed").size() : 0;
+        });
+
+        cout << "queryargs: ns per message map=" << mapNs << " flat=" << flatNs
+             << " (" << map.size() << " variables; checksum " << found % 10 << ")" << endl;
+        return 0;
+    }
+
+    // How MorseData was serialized before using JsonWriter
+    string legacySerialize(const RHLab::Morse::MorseData & data) {
+        string result = "{\"morse\":\"";
+        result += data.buffer;
+        result += "\",\"text\":\"";
+        result += data.translatedText;
+        result += "\"}";
+        return result;
+    }
+
+    /*
+     * Throughput of the MorseData report with string concatenation and with JsonWriter.
+     */
+    int benchmarkJson() {
+        const int iterations = 200000;
+        const string morse = ".... . .-.. .-.. ---  .-- --- .-. .-.. -.. ";
+        RHLab::Morse::MorseData data;
+        for (char c : morse)
+            data.addCharacter(c);
+        for (char c : string("HELLO WORLD"))
+            data.addTranslatedCharacter(c);
+
+        char buffer[1024];
+        size_t length = data.serializeTo(buffer, sizeof(buffer));
+        if (string(buffer, length) != legacySerialize(data)) {
+            cerr << "JsonWriter output differs: " << string(buffer, length) << endl;
+            return 1;
+        }
+
+        size_t bytes = 0;
+        double legacyNs = measureNs(iterations, [&](int i) {
+            data.translatedText[0] = 'A' + i % 26;
+            bytes += legacySerialize(data).size();
+        });
+        double writerNs = measureNs(iterations, [&](int i) {
+            data.translatedText[0] = 'A' + i % 26;
+            bytes += data.serializeTo(buffer, sizeof(buffer));
+        });
+
+        cout << "json: ns per report concatenation=" << legacyNs << " (" << length * 1000.0 / legacyNs << " MB/s)"
+             << " JsonWriter=" << writerNs << " (" << length * 1000.0 / writerNs << " MB/s)"
+             << " (" << length << " bytes; checksum " << bytes % 10 << ")" << endl;
+
+        data.addTranslatedCharacter('"');
+        length = data.serializeTo(buffer, sizeof(buffer));
+        cout << "json: report with a quote: " << string(buffer, length) << endl;
+        return 0;
+    }
+
+    /*
+     * Time that sendReport() blocks the simulation with the files communicator, called
+     * directly and through SimulationCommunicatorAsync.
+     */
+    int benchmarkAsyncReports() {
+        const int reports = 2000;
+        const string outputFilename = "bench-output-messages.txt";
+        const string inputFilename = "bench-input-messages.txt";
+        typedef SimulationCommunicatorFiles<BenchmarkReport, BenchmarkRequest> FilesCommunicator;
+        BenchmarkReport report;
+
+        vector<double> syncStalls;
+        {
+            FilesCommunicator communicator(outputFilename, inputFilename);
+            for (int i = 0; i < reports; i++) {
+                report.counter++;
+                auto start = BenchmarkClock::now();
+                communicator.sendReport(report);
+                syncStalls.push_back(elapsedUs(start));
+            }
+        }
+        printLatencies("files (sync) sendReport", syncStalls);
+
+        vector<double> asyncStalls;
+        {
+            SimulationCommunicatorAsync<BenchmarkReport, BenchmarkRequest> communicator(make_shared<FilesCommunicator>(outputFilename, inputFilename));
+            for (int i = 0; i < reports; i++) {
+                report.counter++;
+                auto start = BenchmarkClock::now();
+                communicator.sendReport(report);
+                asyncStalls.push_back(elapsedUs(start));
+                // Roughly the pace of a simulation reporting in every update
+                this_thread::sleep_for(chrono::microseconds(50));
+            }
+            printLatencies("files (async) sendReport", asyncStalls);
+            communicator.printStats(cout);
+        }
+
+        remove(outputFilename.c_str());
+        remove((inputFilename + ".offset").c_str());
+        return 0;
+    }
+
+    /*
+     * Self-test of TimeManagerStd: resolution of getAbsoluteTime() and how late sleepUs()
+     * returns (jitter), compared with std::this_thread::sleep_for.
+     */
+    int benchmarkTime() {
+        LabsLand::Utils::TimeManagerStd timeManager;
+        cout << "spin threshold: " << timeManager.getSpinThresholdUs() << " us" << endl;
+
+        LabsLand::Utils::clock_t previous = timeManager.getAbsoluteTime();
+        LabsLand::Utils::clock_t resolution = 0;
+        for (int i = 0; i < 1000000 && resolution == 0; i++) {
+            LabsLand::Utils::clock_t now = timeManager.getAbsoluteTime();
+            if (now < previous) {
+                cerr << "getAbsoluteTime() went backwards" << endl;
+                return 1;
+            }
+            resolution = now - previous;
+        }
+        cout << "getAbsoluteTime() resolution: " << resolution << " us (" << timeManager.getClocksPerSec() << " clocks per second)" << endl;
+
+        for (uint32_t sleepUs : { 50u, 200u, 1000u, 10000u }) {
+            const int samples = sleepUs >= 10000 ? 50 : 200;
+            vector<double> hybridLateness;
+            vector<double> stdLateness;
+            for (int i = 0; i < samples; i++) {
+                auto start = BenchmarkClock::now();
+                timeManager.sleepUs(sleepUs);
+                hybridLateness.push_back(elapsedUs(start) - sleepUs);
+
+                start = BenchmarkClock::now();
+                this_thread::sleep_for(chrono::microseconds(sleepUs));
+                stdLateness.push_back(elapsedUs(start) - sleepUs);
+            }
+            printLatencies("sleepUs(" + to_string(sleepUs) + ") lateness", hybridLateness);
+            printLatencies("sleep_for(" + to_string(sleepUs) + "us) lateness", stdLateness);
+        }
+        return 0;
+    }
+
+    /*
+     * Appends bytes to a bus input file as the other end does (under the lock, see InputByteLog).
+     */
+    bool appendToBusInput(const string & filename, const vector<unsigned char> & data) {
+        int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        flock(fd, LOCK_EX);
+        bool written = write(fd, data.data(), data.size()) == (ssize_t)data.size();
+        flock(fd, LOCK_UN);
+        close(fd);
+        return written;
+    }
+
+    /*
+     * How the I2C and SPI file wrappers used to pop a byte: reading the whole input and rewriting the rest.
+     */
+    unsigned char legacyReadByte(const string & filename) {
+        ifstream inputFile(filename, ios::binary);
+        vector<char> buffer(istreambuf_iterator<char>(inputFile), {});
+        if (buffer.empty())
+            return 0;
+        unsigned char firstByte = (unsigned char)buffer[0];
+        buffer.erase(buffer.begin());
+        inputFile.close();
+        ofstream inputFileWithoutByte(filename, ios::binary | ios::trunc);
+        inputFileWithoutByte.write(buffer.data(), buffer.size());
+        return firstByte;
+    }
+
+    void ignoreI2cEvent(LabsLand::Protocols::I2C_IO_Wrapper * wrapper, LabsLand::Protocols::I2CEventType event) {
+    }
+
+    /*
+     * Bulk transfers through I2C_IO_WrapperFiles: draining a 4 KB dump (e.g., an EEPROM) from the input
+     * file byte by byte, against the previous whole-file rewrite, and in one burst; and writing it byte
+     * by byte and in one burst.
+     */
+    int benchmarkI2c() {
+        const size_t bytes = 4096;
+        const string outputFilename = "bench-output-i2c.txt";
+        const string inputFilename = "bench-input-i2c.txt";
+        const string signalFilename = "bench-signal-i2c.txt";
+
+        vector<unsigned char> dump(bytes);
+        for (size_t i = 0; i < bytes; i++)
+            dump[i] = (unsigned char)(i * 31 + 7);
+
+        remove(inputFilename.c_str());
+        appendToBusInput(inputFilename, dump);
+        auto start = BenchmarkClock::now();
+        for (size_t i = 0; i < bytes; i++) {
+            if (legacyReadByte(inputFilename) != dump[i]) {
+                cerr << "The legacy read returned a wrong byte at " << i << endl;
+                return 1;
+            }
+        }
+        double legacyUs = elapsedUs(start);
+
+        LabsLand::Protocols::i2cSlaveCallback callback = ignoreI2cEvent;
+        LabsLand::Protocols::I2C_IO_WrapperFiles wrapper;
+        wrapper.initialize(outputFilename, inputFilename, signalFilename, &callback);
+
+        remove(inputFilename.c_str());
+        appendToBusInput(inputFilename, dump);
+        start = BenchmarkClock::now();
+        for (size_t i = 0; i < bytes; i++) {
+            if (wrapper.readByte() != dump[i]) {
+                cerr << "readByte() returned a wrong byte at " << i << endl;
+                return 1;
+            }
+        }
+        double readUs = elapsedUs(start);
+
+        start = BenchmarkClock::now();
+        for (size_t i = 0; i < bytes; i++)
+            wrapper.writeByte(dump[i]);
+        double writeUs = elapsedUs(start);
+
+        // The same in one burst each
+        appendToBusInput(inputFilename, dump);
+        vector<unsigned char> burst(bytes);
+        start = BenchmarkClock::now();
+        size_t burstRead = wrapper.readBytes(burst.data(), bytes);
+        double burstReadUs = elapsedUs(start);
+        if (burstRead != bytes || burst != dump) {
+            cerr << "readBytes() returned " << burstRead << " bytes or wrong ones" << endl;
+            return 1;
+        }
+
+        start = BenchmarkClock::now();
+        wrapper.writeBytes(dump.data(), bytes);
+        double burstWriteUs = elapsedUs(start);
+
+        ifstream outputFile(outputFilename, ios::binary);
+        vector<char> written(istreambuf_iterator<char>(outputFile), {});
+        if (written.size() != 2 * bytes || memcmp(written.data(), dump.data(), bytes) != 0 || memcmp(written.data() + bytes, dump.data(), bytes) != 0) {
+            cerr << "The output has " << written.size() << " bytes instead of the " << 2 * bytes << " written" << endl;
+            return 1;
+        }
+
+        cout << "read " << bytes << " bytes (previous whole-file rewrite): " << legacyUs / 1000 << " ms (" << legacyUs / bytes << " us/byte)" << endl;
+        cout << "read " << bytes << " bytes (readByte): " << readUs / 1000 << " ms (" << readUs / bytes << " us/byte)" << endl;
+        cout << "read " << bytes << " bytes (readBytes): " << burstReadUs / 1000 << " ms" << endl;
+        cout << "write " << bytes << " bytes (writeByte): " << writeUs / 1000 << " ms (" << writeUs / bytes << " us/byte)" << endl;
+        cout << "write " << bytes << " bytes (writeBytes): " << burstWriteUs / 1000 << " ms" << endl;
+
+        remove(outputFilename.c_str());
+        remove(inputFilename.c_str());
+        return 0;
+    }
+
+    void ignoreSpiEvent(LabsLand::Protocols::SPI_IO_Wrapper * wrapper, LabsLand::Protocols::SPIEventType event) {
+    }
+
+    /*
+     * A sensor stream through SPI_IO_WrapperFiles: 4 MB of samples appended to the MOSI file, drained byte
+     * by byte and in 64 KB bursts, as the SPI clock they would sustain (8 bits per byte).
+     */
+    int benchmarkSpi() {
+        const size_t bytes = 4 * 1024 * 1024;
+        const size_t burstBytes = 64 * 1024;
+        const string outputFilename = "bench-output-spi.txt";
+        const string inputFilename = "bench-input-spi.txt";
+        const string signalFilename = "bench-signal-spi.txt";
+
+        vector<unsigned char> stream(bytes);
+        for (size_t i = 0; i < bytes; i++)
+            stream[i] = (unsigned char)(i * 13 + (i >> 8));
+
+        LabsLand::Protocols::spiSlaveCallback callback = ignoreSpiEvent;
+        LabsLand::Protocols::SPI_IO_WrapperFiles wrapper;
+        remove(inputFilename.c_str());
+        wrapper.initialize(outputFilename, inputFilename, signalFilename, &callback);
+
+        appendToBusInput(inputFilename, stream);
+        auto start = BenchmarkClock::now();
+        for (size_t i = 0; i < bytes; i++) {
+            if (wrapper.readByte() != stream[i]) {
+                cerr << "readByte() returned a wrong byte at " << i << endl;
+                return 1;
+            }
+        }
+        double byteUs = elapsedUs(start);
+
+        appendToBusInput(inputFilename, stream);
+        vector<unsigned char> burst(burstBytes);
+        start = BenchmarkClock::now();
+        for (size_t offset = 0; offset < bytes; offset += burstBytes) {
+            size_t received = wrapper.readBytes(burst.data(), burstBytes);
+            if (received != burstBytes || memcmp(burst.data(), stream.data() + offset, burstBytes) != 0) {
+                cerr << "readBytes() returned " << received << " bytes or wrong ones at " << offset << endl;
+                return 1;
+            }
+        }
+        double burstUs = elapsedUs(start);
+
+        cout << "read " << bytes << " bytes (readByte): " << byteUs / 1000 << " ms (" << bytes * 8 / byteUs << " MHz equivalent)" << endl;
+        cout << "read " << bytes << " bytes (readBytes, " << burstBytes << " byte bursts): " << burstUs / 1000 << " ms (" << bytes * 8 / burstUs << " MHz equivalent)" << endl;
+
+        remove(outputFilename.c_str());
+        remove(inputFilename.c_str());
+        return 0;
+    }
+
+    mutex i2cSignalMutex;
+    condition_variable i2cSignalCondition;
+    uint64_t i2cSignalCallbacks = 0;
+    uint64_t i2cSignalCallbackNs = 0;
+
+    void countI2cEvent(LabsLand::Protocols::I2C_IO_Wrapper * wrapper, LabsLand::Protocols::I2CEventType event) {
+        uint64_t now = LabsLand::Protocols::SignalFileMonitor::nowNs();
+        lock_guard<mutex> lock(i2cSignalMutex);
+        i2cSignalCallbacks++;
+        i2cSignalCallbackNs = now;
+        i2cSignalCondition.notify_all();
+    }
+
+    /*
+     * Time from an I2C signal (writing the signal file, or signal() in the same process) to its callback,
+     * which used to be up to the 100 ms the monitoring thread slept between reads of the file.
+     */
+    int benchmarkI2cSignals() {
+        const int transactions = 200;
+        const string outputFilename = "bench-output-i2c.txt";
+        const string inputFilename = "bench-input-i2c.txt";
+        const string signalFilename = "bench-signal-i2c.txt";
+        remove(signalFilename.c_str());
+
+        LabsLand::Protocols::i2cSlaveCallback callback = countI2cEvent;
+        LabsLand::Protocols::I2C_IO_WrapperFiles wrapper;
+        wrapper.initialize(outputFilename, inputFilename, signalFilename, &callback);
+
+        for (int inProcess = 0; inProcess < 2; inProcess++) {
+            vector<double> latenciesUs;
+            {
+                lock_guard<mutex> lock(i2cSignalMutex);
+                i2cSignalCallbacks = 0;
+            }
+            uint64_t acknowledged = wrapper.getSignalStats().transactions;
+
+            for (int i = 0; i < transactions; i++) {
+                uint64_t signalNs = LabsLand::Protocols::SignalFileMonitor::nowNs();
+                if (inProcess) {
+                    wrapper.signal(LabsLand::Protocols::I2CEventType::slaveRequest);
+                } else {
+                    ofstream signalFile(signalFilename);
+                    signalFile << "request";
+                }
+
+                unique_lock<mutex> lock(i2cSignalMutex);
+                if (!i2cSignalCondition.wait_for(lock, chrono::seconds(2), [&] { return i2cSignalCallbacks > (uint64_t)i; })) {
+                    cerr << "The callback of signal " << i << " was not called" << endl;
+                    return 1;
+                }
+                latenciesUs.push_back((i2cSignalCallbackNs - signalNs) / 1000.0);
+                lock.unlock();
+
+                // The next signal must not be written before this one is acknowledged (its file removed)
+                acknowledged++;
+                while (wrapper.getSignalStats().transactions < acknowledged)
+                    this_thread::yield();
+            }
+
+            sort(latenciesUs.begin(), latenciesUs.end());
+            cout << (inProcess ? "signal() to callback: " : "signal file to callback: ")
+                 << "p50 " << latenciesUs[transactions / 2] << " us, p99 " << latenciesUs[transactions * 99 / 100]
+                 << " us, max " << latenciesUs.back() << " us" << endl;
+        }
+
+        cout << "recorded by the wrapper: ";
+        wrapper.getSignalStats().print(cout);
+
+        remove(outputFilename.c_str());
+        remove(inputFilename.c_str());
+        return 0;
+    }
+
+    /*
+     * Keeps the last bytes written to it, and answers requests with them.
+     */
+    class EchoSlave : public LabsLand::Protocols::I2CSlaveHandler {
+        public:
+            vector<unsigned char> last;
+            int received = 0;
+
+            virtual void onReceive(const unsigned char * data, size_t length) override {
+                last.assign(data, data + length);
+                received++;
+            }
+
+            virtual size_t onRequest(unsigned char * data, size_t length) override {
+                size_t filled = length < last.size() ? length : last.size();
+                memcpy(data, last.data(), filled);
+                return filled;
+            }
+    };
+
+    /*
+     * Waits until the wrapper has handled (acknowledged) the given number of transactions.
+     */
+    bool waitForTransactions(LabsLand::Protocols::I2C_IO_WrapperFiles & wrapper, uint64_t transactions) {
+        auto deadline = BenchmarkClock::now() + chrono::seconds(2);
+        while (wrapper.getSignalStats().transactions < transactions) {
+            if (BenchmarkClock::now() > deadline)
+                return false;
+            this_thread::yield();
+        }
+        return true;
+    }
+
+    /*
+     * 100 slaves behind one I2CRouter (one channel, one thread): a write and a read-back to each of them,
+     * and a write to an address without a slave.
+     */
+    int benchmarkI2cRouter() {
+        const int slaves = 100;
+        const int rounds = 10;
+        const string outputFilename = "bench-output-i2c.txt";
+        const string inputFilename = "bench-input-i2c.txt";
+        const string signalFilename = "bench-signal-i2c.txt";
+        remove(inputFilename.c_str());
+        remove(signalFilename.c_str());
+
+        vector<EchoSlave> echoes(slaves);
+        LabsLand::Protocols::I2CRouter router;
+        for (int i = 0; i < slaves; i++)
+            router.addSlave(0x08 + i, &echoes[i]);
+
+        LabsLand::Protocols::I2C_IO_WrapperFiles wrapper;
+        wrapper.initialize(outputFilename, inputFilename, signalFilename, &router);
+
+        uint64_t transactions = 0;
+        auto start = BenchmarkClock::now();
+        for (int round = 0; round < rounds; round++) {
+            for (int i = 0; i < slaves; i++) {
+                unsigned char address = 0x08 + i;
+                // As a master, every transaction waits for the previous one to be handled
+                appendToBusInput(inputFilename, { (unsigned char)(address << 1), (unsigned char)round, (unsigned char)i });
+                wrapper.signal(LabsLand::Protocols::I2CEventType::slaveReceive);
+                if (!waitForTransactions(wrapper, ++transactions))
+                    break;
+                appendToBusInput(inputFilename, { (unsigned char)((address << 1) | 1), 0, 2 });
+                wrapper.signal(LabsLand::Protocols::I2CEventType::slaveRequest);
+                if (!waitForTransactions(wrapper, ++transactions))
+                    break;
+            }
+            if (wrapper.getSignalStats().transactions < transactions) {
+                cerr << "The transactions of round " << round << " were not handled" << endl;
+                return 1;
+            }
+        }
+        double elapsed = elapsedUs(start);
+
+        appendToBusInput(inputFilename, { 0x7f << 1, 1, 2, 3 });
+        wrapper.signal(LabsLand::Protocols::I2CEventType::slaveReceive);
+        if (!waitForTransactions(wrapper, transactions + 1))
+            return 1;
+
+        ifstream outputFile(outputFilename, ios::binary);
+        vector<unsigned char> written((istreambuf_iterator<char>(outputFile)), {});
+        size_t expected = 0;
+        for (int round = 0; round < rounds; round++)
+            for (int i = 0; i < slaves; i++, expected += 2)
+                if (written.size() < expected + 2 || written[expected] != round || written[expected + 1] != i) {
+                    cerr << "Wrong read-back from slave " << i << " in round " << round << endl;
+                    return 1;
+                }
+        if (router.getNacks() != 1 || router.getTransactions() != transactions) {
+            cerr << router.getTransactions() << " transactions and " << router.getNacks() << " NACKs were routed" << endl;
+            return 1;
+        }
+
+        cout << transactions << " transactions to " << slaves << " slaves on one thread: "
+             << elapsed / transactions << " us per transaction" << endl;
+
+        remove(outputFilename.c_str());
+        remove(inputFilename.c_str());
+        return 0;
+    }
+
+    /*
+     * One transaction of a master through the I2C file wrapper: the address byte and data (the number of
+     * bytes to read, in requests), then the signal, waiting until it is handled.
+     */
+    bool runI2cTransaction(LabsLand::Protocols::I2C_IO_WrapperFiles & wrapper, const string & inputFilename, uint64_t & transactions,
+                unsigned int address, LabsLand::Protocols::I2CEventType event, const vector<unsigned char> & data) {
+        vector<unsigned char> input = { (unsigned char)((address << 1) | (event == LabsLand::Protocols::I2CEventType::slaveRequest ? 1 : 0)) };
+        input.insert(input.end(), data.begin(), data.end());
+        appendToBusInput(inputFilename, input);
+        wrapper.signal(event);
+        return waitForTransactions(wrapper, ++transactions);
+    }
+
+    /*
+     * The reference I2C devices behind a router: programming a 24C256 EEPROM page by page (polling it
+     * during its write cycles) and reading it back in one 32 KB burst; the alert of the temperature sensor
+     * and clearing it; and the pins of a PCF8574.
+     */
+    int benchmarkI2cDevices() {
+        using LabsLand::Protocols::I2CEventType;
+        const string outputFilename = "bench-output-i2c.txt";
+        const string inputFilename = "bench-input-i2c.txt";
+        const string signalFilename = "bench-signal-i2c.txt";
+        remove(inputFilename.c_str());
+        remove(signalFilename.c_str());
+
+        shared_ptr<LabsLand::Utils::TimeManager> timeManager = make_shared<LabsLand::Utils::TimeManagerStd>();
+        LabsLand::Protocols::EEPROM24C256 eeprom(timeManager);
+        LabsLand::Protocols::TemperatureSensor sensor;
+        LabsLand::Protocols::PCF8574 expander;
+        LabsLand::Protocols::I2CRouter router;
+        router.addSlave(LabsLand::Protocols::EEPROM24C256::DEFAULT_ADDRESS, &eeprom);
+        router.addSlave(LabsLand::Protocols::TemperatureSensor::DEFAULT_ADDRESS, &sensor);
+        router.addSlave(LabsLand::Protocols::PCF8574::DEFAULT_ADDRESS, &expander);
+
+        LabsLand::Protocols::I2C_IO_WrapperFiles wrapper;
+        wrapper.initialize(outputFilename, inputFilename, signalFilename, &router);
+        uint64_t transactions = 0;
+
+        // Only the first 4 pages (with ACK polling), the rest is written by the simulation
+        const size_t size = eeprom.getSize();
+        vector<unsigned char> image(size);
+        for (size_t i = 0; i < size; i++)
+            image[i] = (unsigned char)(i * 7 + 3);
+        auto start = BenchmarkClock::now();
+        unsigned long polls = 0;
+        for (size_t page = 0; page < 4; page++) {
+            vector<unsigned char> write = { (unsigned char)(page * 64 >> 8), (unsigned char)(page * 64) };
+            write.insert(write.end(), image.begin() + page * 64, image.begin() + (page + 1) * 64);
+            unsigned long nacks = router.getNacks();
+            if (!runI2cTransaction(wrapper, inputFilename, transactions, LabsLand::Protocols::EEPROM24C256::DEFAULT_ADDRESS, I2CEventType::slaveReceive, write))
+                return 1;
+            while (router.getNacks() > nacks) {
+                // Busy: the master retries the write until the EEPROM answers
+                polls++;
+                nacks = router.getNacks();
+                if (!runI2cTransaction(wrapper, inputFilename, transactions, LabsLand::Protocols::EEPROM24C256::DEFAULT_ADDRESS, I2CEventType::slaveReceive, write))
+                    return 1;
+            }
+        }
+        double programUs = elapsedUs(start);
+        eeprom.setRegisters(256, image.data() + 256, size - 256);
+
+        // Waits for the last write cycle, sets the pointer to 0 and reads everything
+        timeManager->sleepUs(LabsLand::Protocols::I2CEEPROM::WRITE_CYCLE_US);
+        size_t outputOffset = 0;
+        start = BenchmarkClock::now();
+        if (!runI2cTransaction(wrapper, inputFilename, transactions, LabsLand::Protocols::EEPROM24C256::DEFAULT_ADDRESS, I2CEventType::slaveReceive, { 0, 0 }) ||
+                !runI2cTransaction(wrapper, inputFilename, transactions, LabsLand::Protocols::EEPROM24C256::DEFAULT_ADDRESS, I2CEventType::slaveRequest, { (unsigned char)(size >> 8), (unsigned char)size }))
+            return 1;
+        double readUs = elapsedUs(start);
+
+        ifstream outputFile(outputFilename, ios::binary);
+        vector<unsigned char> written((istreambuf_iterator<char>(outputFile)), {});
+        if (written.size() != size || !equal(written.begin(), written.end(), image.begin())) {
+            cerr << "The EEPROM returned " << written.size() << " bytes or wrong ones" << endl;
+            return 1;
+        }
+        outputOffset = written.size();
+
+        // Temperature over the limit: the alert is set until the master clears it, and the temperature is read-only
+        sensor.setTemperature(85.5);
+        const unsigned int sensorAddress = LabsLand::Protocols::TemperatureSensor::DEFAULT_ADDRESS;
+        if (!runI2cTransaction(wrapper, inputFilename, transactions, sensorAddress, I2CEventType::slaveReceive, { 0x00, 0x12, 0x34 }) ||
+                !runI2cTransaction(wrapper, inputFilename, transactions, sensorAddress, I2CEventType::slaveReceive, { 0x00 }) ||
+                !runI2cTransaction(wrapper, inputFilename, transactions, sensorAddress, I2CEventType::slaveRequest, { 0, 4 }) ||
+                !runI2cTransaction(wrapper, inputFilename, transactions, sensorAddress, I2CEventType::slaveReceive, { 0x03, LabsLand::Protocols::TemperatureSensor::ALERT_HIGH }))
+            return 1;
+        if (sensor.getRegister(LabsLand::Protocols::TemperatureSensor::STATUS) != 0) {
+            cerr << "The alert of the temperature sensor was not cleared" << endl;
+            return 1;
+        }
+
+        // The master drives the low nibble of the expander, and something outside pulls pin 7 low
+        const unsigned int expanderAddress = LabsLand::Protocols::PCF8574::DEFAULT_ADDRESS;
+        expander.setInputs(0x7F);
+        if (!runI2cTransaction(wrapper, inputFilename, transactions, expanderAddress, I2CEventType::slaveReceive, { 0xF5 }) ||
+                !runI2cTransaction(wrapper, inputFilename, transactions, expanderAddress, I2CEventType::slaveRequest, { 0, 1 }))
+            return 1;
+
+        outputFile.close();
+        outputFile.open(outputFilename, ios::binary);
+        written.assign(istreambuf_iterator<char>(outputFile), {});
+        const vector<unsigned char> expected = { 85, 0x80, 0x00, LabsLand::Protocols::TemperatureSensor::ALERT_HIGH, 0x75 };
+        if (written.size() != outputOffset + expected.size() || !equal(expected.begin(), expected.end(), written.begin() + outputOffset)) {
+            cerr << "The sensor or the expander returned wrong bytes" << endl;
+            return 1;
+        }
+        if (expander.getOutputs() != 0xF5) {
+            cerr << "The outputs of the expander are wrong" << endl;
+            return 1;
+        }
+
+        cout << "EEPROM: 4 pages of 64 bytes written in " << programUs / 1000 << " ms (" << polls << " polls during the write cycles)" << endl;
+        cout << "EEPROM: " << size << " bytes read in one burst in " << readUs / 1000 << " ms (pointer write included)" << endl;
+        cout << "temperature sensor and PCF8574: OK" << endl;
+
+        remove(outputFilename.c_str());
+        remove(inputFilename.c_str());
+        return 0;
+    }
+
+    /*
+     * Checks the timer wheel against a plain list of timers (getNextExpiry() and the order in which they
+     * fire, including timers further than 64^4 ticks away), then measures scheduling and cancelling.
+     */
+    int benchmarkTimerWheel() {
+        using LabsLand::Utils::TimerWheel;
+        const LabsLand::Utils::clock_t TICK = 1000;
+
+        // A timer beyond the last level must not hide a nearer one scheduled after the wheel moved
+        TimerWheel wheel(TICK, 0);
+        wheel.schedule(20000000000ull);
+        wheel.advance(262144000ull, [](TimerWheel::TimerId, uint32_t) {});
+        wheel.schedule(16778216000ull);
+        if (wheel.getNextExpiry() != 16778216000ull) {
+            cerr << "getNextExpiry() returned " << wheel.getNextExpiry() << " instead of 16778216000" << endl;
+            return 1;
+        }
+
+        mt19937_64 random(42);
+        const int TRIALS = 200;
+        for (int trial = 0; trial < TRIALS; trial++) {
+            LabsLand::Utils::clock_t now = random() % 1000000000000ull;
+            wheel.reset(TICK, now);
+            // Expiry tick of every scheduled timer, by tag
+            vector<uint64_t> expected;
+            vector<TimerWheel::TimerId> ids;
+            for (int step = 0; step < 100; step++) {
+                uint64_t action = random() % 10;
+                if (action < 5) {
+                    // Near, far and beyond the last level
+                    uint64_t ranges[] = { 100ull, 5000000ull, 30000000000ull };
+                    LabsLand::Utils::clock_t expiry = now + random() % ranges[random() % 3] * TICK + random() % TICK;
+                    uint64_t expiryTick = max((expiry + TICK - 1) / TICK, now / TICK + 1);
+                    ids.push_back(wheel.schedule(expiry, (uint32_t)expected.size()));
+                    expected.push_back(expiryTick);
+                } else if (action < 7 && !ids.empty()) {
+                    size_t tag = random() % ids.size();
+                    bool cancelled = wheel.cancel(ids[tag]);
+                    if (cancelled != (expected[tag] != 0)) {
+                        cerr << "Trial " << trial << ": cancel() returned " << cancelled << endl;
+                        return 1;
+                    }
+                    expected[tag] = 0;
+                } else {
+                    now += random() % (action == 9 ? 20000000000ull : 5000000ull);
+                    uint64_t lastTick = 0;
+                    bool failed = false;
+                    wheel.advance(now, [&](TimerWheel::TimerId, uint32_t tag) {
+                        if (expected[tag] == 0 || expected[tag] > now / TICK || expected[tag] < lastTick)
+                            failed = true;
+                        lastTick = expected[tag];
+                        expected[tag] = 0;
+                    });
+                    for (uint64_t expiryTick : expected)
+                        failed = failed || (expiryTick != 0 && expiryTick <= now / TICK);
+                    if (failed) {
+                        cerr << "Trial " << trial << ": the timers did not fire as expected" << endl;
+                        return 1;
+                    }
+                }
+
+                uint64_t nextTick = UINT64_MAX;
+                for (uint64_t expiryTick : expected)
+                    if (expiryTick != 0)
+                        nextTick = min(nextTick, expiryTick);
+                LabsLand::Utils::clock_t nextExpiry = nextTick == UINT64_MAX ? TimerWheel::NEVER : nextTick * TICK;
+                if (wheel.getNextExpiry() != nextExpiry) {
+                    cerr << "Trial " << trial << ": getNextExpiry() returned " << wheel.getNextExpiry() << " instead of " << nextExpiry << endl;
+                    return 1;
+                }
+            }
+        }
+        cout << "getNextExpiry() and expiries match a plain list of timers in " << TRIALS << " random trials" << endl;
+
+        const int TIMERS = 100000;
+        wheel.reset(TICK, 0);
+        vector<TimerWheel::TimerId> ids(TIMERS);
+        auto start = BenchmarkClock::now();
+        for (int i = 0; i < TIMERS; i++)
+            ids[i] = wheel.schedule((random() % 10000000) * TICK);
+        for (int i = 0; i < TIMERS; i++)
+            wheel.cancel(ids[i]);
+        double elapsedNs = chrono::duration<double, nano>(BenchmarkClock::now() - start).count();
+        cout << "schedule + cancel: " << elapsedNs / TIMERS << " ns per timer" << endl;
+        return 0;
+    }
+
+    struct Benchmark {
+        const char * name;
+        const char * description;
+        function<int()> run;
+    };
+
+    const vector<Benchmark> & getBenchmarks() {
+        static const vector<Benchmark> benchmarks = {
+            { "communicators", "report latency of the files, socket and shared memory communicators", benchmarkCommunicators },
+            { "time", "self-test of the resolution and the sleep jitter of TimeManagerStd", benchmarkTime },
+            { "async", "time sendReport() blocks the simulation, with and without the async publisher", benchmarkAsyncReports },
+            { "serializers", "stringstream serialization against the field descriptor serializers", benchmarkSerializers },
+            { "queryargs", "map-based query string parsing against the allocation-free one", benchmarkQueryArgs },
+            { "json", "string concatenation against JsonWriter for the morse reports", benchmarkJson },
+            { "i2c", "draining and writing a 4 KB dump through the I2C file wrapper, byte by byte and in bursts", benchmarkI2c },
+            { "spi", "streaming 4 MB of sensor samples through the SPI file wrapper, byte by byte and in bursts", benchmarkSpi },
+            { "i2c-router", "write and read-back transactions to 100 slaves behind one I2C router", benchmarkI2cRouter },
+            { "i2c-devices", "24C256 EEPROM, temperature sensor and PCF8574 models behind an I2C router", benchmarkI2cDevices },
+            { "timers", "timer wheel against a plain list of timers, and the cost of scheduling and cancelling", benchmarkTimerWheel },
+            { "i2c-signals", "time from an I2C signal (file or in-process) to its callback", benchmarkI2cSignals },
+        };
+        return benchmarks;
+    }
+}
+
+int runBenchmark(const string & name) {
+    for (const Benchmark & benchmark : getBenchmarks()) {
+        if (name == benchmark.name || name == "all") {
+            cout << "== " << benchmark.name << " (" << benchmark.description << ")" << endl;
+            int result = benchmark.run();
+            if (result != 0 || name != "all")
+                return result;
+        }
+    }
+
+    if (name == "all")
+        return 0;
+
+    cerr << "Unknown benchmark: '" << name << "'. Available benchmarks:" << endl;
+    for (const Benchmark & benchmark : getBenchmarks())
+        cerr << "    " << benchmark.name << ": " << benchmark.description << endl;
+    return 2;
+}
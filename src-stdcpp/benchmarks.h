@@ -0,0 +1,22 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef HYBRIDAPI_BENCHMARKS_H
+#define HYBRIDAPI_BENCHMARKS_H
+
+#include <string>
+
+/*
+ * Built-in benchmarks of the standard C++ runtime, run with:
+ *
+ *     ./hybridapi bench <name>
+ *
+ * Returns the process exit code (0 on success, 2 if the benchmark does not exist).
+ */
+int runBenchmark(const std::string & name);
+
+#endif
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LABSLAND_PROTOCOLS_BYTE_LOG_FILES_H
+#define LABSLAND_PROTOCOLS_BYTE_LOG_FILES_H
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+namespace LabsLand::Protocols {
+
+    /**
+     * The input of a bus (e.g., the bytes the master sends to an I2C slave) as an append-only file:
+     * the other end appends bytes, and they are consumed in order from a read offset kept in memory,
+     * so every byte costs O(1) instead of rewriting the rest of the file. Bytes are read from the
+     * file in blocks.
+     *
+     * Once every byte has been consumed, the file is truncated. The other end must append under
+     * flock(LOCK_EX), as this class truncates under the same lock, so no byte is lost in between.
+     */
+    class InputByteLog {
+        private:
+            std::string filename;
+            int fd = -1;
+            // Offset in the file of the first byte not in the block yet
+            off_t fileOffset = 0;
+            unsigned char block[4096];
+            size_t blockPosition = 0;
+            size_t blockLength = 0;
+
+            bool openFile() {
+                if (fd >= 0)
+                    return true;
+                // Read-only, so reading does not look like a write to watchers of the file
+                fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+                return fd >= 0;
+            }
+
+            void closeFile() {
+                if (fd >= 0)
+                    close(fd);
+                fd = -1;
+            }
+
+            /*
+             * Reads the next bytes of the file (up to capacity) into destination. Returns how many were
+             * read: 0 if every byte has been consumed.
+             */
+            size_t fill(unsigned char * destination, size_t capacity) {
+                if (!openFile())
+                    return 0;
+
+                struct stat status;
+                if (fstat(fd, &status) != 0)
+                    return 0;
+                if (status.st_nlink == 0) {
+                    // The file was replaced: read the new one from the beginning
+                    closeFile();
+                    fileOffset = 0;
+                    if (!openFile() || fstat(fd, &status) != 0)
+                        return 0;
+                }
+                if (status.st_size < fileOffset) {
+                    // Truncated by someone else: start again
+                    fileOffset = 0;
+                }
+
+                if (status.st_size == fileOffset) {
+                    if (fileOffset > 0)
+                        compact();
+                    return 0;
+                }
+
+                ssize_t length = pread(fd, destination, capacity, fileOffset);
+                if (length <= 0)
+                    return 0;
+                fileOffset += length;
+                return length;
+            }
+
+            /*
+             * Reads the next block of the file. Returns false if every byte has been consumed.
+             */
+            bool refill() {
+                blockPosition = 0;
+                blockLength = fill(block, sizeof(block));
+                return blockLength > 0;
+            }
+
+            /*
+             * Truncates the file once all of its bytes have been consumed.
+             */
+            void compact() {
+                int writeFd = open(filename.c_str(), O_RDWR | O_CLOEXEC);
+                if (writeFd < 0)
+                    return;
+                if (flock(writeFd, LOCK_EX) == 0) {
+                    struct stat status;
+                    if (fstat(writeFd, &status) == 0 && status.st_size == fileOffset && ftruncate(writeFd, 0) == 0)
+                        fileOffset = 0;
+                    flock(writeFd, LOCK_UN);
+                }
+                close(writeFd);
+            }
+
+        public:
+            InputByteLog() {}
+
+            ~InputByteLog() {
+                closeFile();
+            }
+
+            InputByteLog(const InputByteLog &) = delete;
+            InputByteLog & operator=(const InputByteLog &) = delete;
+
+            /*
+             * Starts reading filename from the beginning.
+             */
+            void setFilename(const std::string & newFilename) {
+                closeFile();
+                filename = newFilename;
+                fileOffset = 0;
+                blockPosition = blockLength = 0;
+            }
+
+            /*
+             * Pops the next byte. Returns false if there is none.
+             */
+            bool read(unsigned char & byte) {
+                if (blockPosition == blockLength && !refill())
+                    return false;
+                byte = block[blockPosition++];
+                return true;
+            }
+
+            /*
+             * Pops up to length bytes. Returns how many were popped.
+             */
+            size_t read(unsigned char * data, size_t length) {
+                size_t copied = 0;
+                while (copied < length) {
+                    if (blockPosition == blockLength && length - copied >= sizeof(block)) {
+                        // Large bursts (e.g., a sensor stream) go straight to data, without the copy through the block
+                        size_t direct = fill(data + copied, length - copied);
+                        if (direct == 0)
+                            break;
+                        copied += direct;
+                        continue;
+                    }
+                    if (blockPosition == blockLength && !refill())
+                        break;
+                    size_t chunk = length - copied < blockLength - blockPosition ? length - copied : blockLength - blockPosition;
+                    memcpy(data + copied, block + blockPosition, chunk);
+                    blockPosition += chunk;
+                    copied += chunk;
+                }
+                return copied;
+            }
+    };
+
+    /**
+     * The output of a bus as an append-only file: every write appends (under flock(LOCK_EX), so the
+     * other end can truncate the file once it has consumed it, as InputByteLog does). The file is kept
+     * open, so a burst costs the same few syscalls whatever its length.
+     */
+    class OutputByteLog {
+        private:
+            std::string filename;
+            int fd = -1;
+
+            bool openFile(int extraFlags) {
+                if (fd >= 0)
+                    close(fd);
+                fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | extraFlags, 0644);
+                if (fd < 0)
+                    perror(("Could not open " + filename).c_str());
+                return fd >= 0;
+            }
+
+        public:
+            OutputByteLog() {}
+
+            ~OutputByteLog() {
+                if (fd >= 0)
+                    close(fd);
+            }
+
+            OutputByteLog(const OutputByteLog &) = delete;
+            OutputByteLog & operator=(const OutputByteLog &) = delete;
+
+            /*
+             * Writes to filename from now on, emptying it.
+             */
+            void setFilename(const std::string & newFilename) {
+                filename = newFilename;
+                openFile(O_TRUNC);
+            }
+
+            /*
+             * Appends length bytes. Returns how many were written.
+             */
+            size_t write(const unsigned char * data, size_t length) {
+                struct stat status;
+                if (fd < 0 || fstat(fd, &status) != 0 || status.st_nlink == 0) {
+                    // The file was removed or replaced: write to the one with the name
+                    if (!openFile(0))
+                        return 0;
+                }
+
+                flock(fd, LOCK_EX);
+                size_t written = 0;
+                while (written < length) {
+                    ssize_t result = ::write(fd, data + written, length - written);
+                    if (result <= 0)
+                        break;
+                    written += result;
+                }
+                flock(fd, LOCK_UN);
+                return written;
+            }
+    };
+}
+
+#endif
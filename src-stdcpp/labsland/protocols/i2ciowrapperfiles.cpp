@@ -5,11 +5,7 @@
  * This software is licensed as described in the file LICENSE, which
  * you should have received as part of this distribution.
  */
-#include <chrono>
 #include <cstdio>
-#include <vector>
-#include <fstream>
-#include <sstream>
 #include <iostream>
 
 #include "i2ciowrapperfiles.h"
@@ -21,111 +17,112 @@ I2C_IO_WrapperFiles::I2C_IO_WrapperFiles() {
 }
 
 I2C_IO_WrapperFiles::~I2C_IO_WrapperFiles() {
+    this->stopMonitoringThread();
+}
+
+void I2C_IO_WrapperFiles::stopMonitoringThread() {
     if (this->monitoringThread != 0) {
         this->continueRunning = false;
+        this->signalMonitor->stop();
         this->monitoringThread->join();
         delete this->monitoringThread;
         this->monitoringThread = 0;
     }
 }
 
-void runI2cThread(I2C_IO_WrapperFiles * i2cInstance, 
-            const std::string & outputFile, const std::string & inputFile, const std::string & signalFile, 
-            const i2cSlaveCallback * callback) {
+void runI2cThread(I2C_IO_WrapperFiles * i2cInstance, SignalFileMonitor * signalMonitor,
+            const std::string & outputFile, const i2cSlaveCallback * callback, I2CRouter * router) {
     
-    if (callback == 0) {
+    if (callback == 0 && router == 0) {
         cerr << "Received null callback for I2C with output file " << outputFile << " - stopping thread " << endl;
         return;
     }
 
-    while (i2cInstance->shouldContinueRunning()) {
-        this_thread::sleep_for(chrono::milliseconds(100));
-
-        ifstream signalFileObj(signalFile);
-
-        // if it does not exist, continue
-        if (!signalFileObj || !signalFileObj.good())
-            continue;
-
-        stringstream buffer;                      
-        buffer << signalFileObj.rdbuf();                    
-        string currentSignal = buffer.str();          
-        signalFileObj.close();
-
-        if (currentSignal == "request") {
-            (*callback)(i2cInstance, I2CEventType::slaveRequest);
-        } else if(currentSignal == "receive") {
-            (*callback)(i2cInstance, I2CEventType::slaveReceive);
-        } else if(currentSignal == "finish") {
-            (*callback)(i2cInstance, I2CEventType::slaveFinish);
+    SignalFileMonitor::Signal signal;
+    while (i2cInstance->shouldContinueRunning() && signalMonitor->wait(signal)) {
+        uint64_t callbackStart = SignalFileMonitor::nowNs();
+
+        I2CEventType event;
+        if (signal.name == "request") {
+            event = I2CEventType::slaveRequest;
+        } else if(signal.name == "receive") {
+            event = I2CEventType::slaveReceive;
+        } else if(signal.name == "finish") {
+            event = I2CEventType::slaveFinish;
         } else {
-            // Maybe we have a partial read or something, but just ignore it.
+            // Maybe we have a partial read or something, but just ignore it (until the file is written again).
             continue;
         }
 
-        remove(signalFile.c_str());
+        if (router != 0)
+            router->handleEvent(i2cInstance, event);
+        else
+            (*callback)(i2cInstance, event);
+
+        signalMonitor->acknowledge(signal, callbackStart);
     }
 }
 
 void I2C_IO_WrapperFiles::initialize(const string & outputFile, const string & inputFile, const string & signalFile, const i2cSlaveCallback * callback) {
+    this->startMonitoringThread(outputFile, inputFile, signalFile, callback, 0);
+}
+
+void I2C_IO_WrapperFiles::initialize(const string & outputFile, const string & inputFile, const string & signalFile, I2CRouter * router) {
+    this->startMonitoringThread(outputFile, inputFile, signalFile, 0, router);
+}
+
+void I2C_IO_WrapperFiles::startMonitoringThread(const string & outputFile, const string & inputFile, const string & signalFile, const i2cSlaveCallback * callback, I2CRouter * router) {
     this->inputFileName = inputFile;
     this->outputFileName = outputFile;
 
-    // truncate the file (so we restart it every time we initialize())
-    std::ofstream newOutputFile(this->outputFileName, ios::binary | ios::trunc);
-    newOutputFile.close();
+    // truncate the output (so we restart it every time we initialize())
+    this->output.setFilename(this->outputFileName);
+    this->input.setFilename(this->inputFileName);
 
-    if (this->monitoringThread != 0) {
-        this->continueRunning = false;
-        this->monitoringThread->join();
-        delete this->monitoringThread;
-        this->monitoringThread = 0;
-    }
-    
-    this->continueRunning = true;
-    this->monitoringThread = new thread(runI2cThread, this, outputFile, inputFile, signalFile, callback);
-}
+    this->stopMonitoringThread();
 
-bool I2C_IO_WrapperFiles::shouldContinueRunning () {
-    return this->continueRunning;
+    // The signal file is watched before the thread starts, so no signal is missed
+    this->signalMonitor.reset(new SignalFileMonitor(signalFile));
+    this->continueRunning = true;
+    this->monitoringThread = new thread(runI2cThread, this, this->signalMonitor.get(), outputFile, callback, router);
 }
 
-
-unsigned char I2C_IO_WrapperFiles::readByte() {
-    ifstream inputFile(this->inputFileName, ios::binary);
-    if (!inputFile || !inputFile.good()) {
-        return 0;
-    }
-
-    // Read the entire file into a vector
-    std::vector<char> buffer(std::istreambuf_iterator<char>(inputFile), {});
-    if (buffer.empty()) {
-        // No first byte
-        return 0;
+void I2C_IO_WrapperFiles::signal(I2CEventType event) {
+    if (!this->signalMonitor)
+        return;
+    switch (event) {
+        case I2CEventType::slaveRequest:
+            this->signalMonitor->queue("request");
+            break;
+        case I2CEventType::slaveReceive:
+            this->signalMonitor->queue("receive");
+            break;
+        case I2CEventType::slaveFinish:
+            this->signalMonitor->queue("finish");
+            break;
+        default:
+            break;
     }
+}
 
-    // take the first byte (and will return it)
-    unsigned char firstByte = (unsigned char)buffer[0];
-    buffer.erase(buffer.begin());
+SignalFileMonitor::Stats I2C_IO_WrapperFiles::getSignalStats() {
+    if (!this->signalMonitor)
+        return SignalFileMonitor::Stats();
+    return this->signalMonitor->getStats();
+}
 
-    inputFile.close();
+bool I2C_IO_WrapperFiles::shouldContinueRunning () {
+    return this->continueRunning;
+}
 
-    // rewrite the file without that byte
-    ofstream inputFileWithoutByte(this->inputFileName, ios::binary | ios::trunc);
-    inputFileWithoutByte.write(buffer.data(), buffer.size());
-    inputFileWithoutByte.close();
 
-    return firstByte;
+size_t I2C_IO_WrapperFiles::readBytes(unsigned char * data, size_t length) {
+    return this->input.read(data, length);
 }
 
-void I2C_IO_WrapperFiles::writeByte(unsigned char byte) {
-    std::ofstream outputFile(this->outputFileName, ios::binary | ios::trunc);
-    if (!outputFile) {
-        perror("Coult not open I2C output file");
-        return;
-    }
-    char byteToSend = (char)byte;
-    outputFile.write(&byteToSend, 1);
-    outputFile.close();
+size_t I2C_IO_WrapperFiles::writeBytes(const unsigned char * data, size_t length) {
+    size_t written = this->output.write(data, length);
+    if (written < length)
+        cerr << "Could not write to the I2C output file " << this->outputFileName << endl;
+    return written;
 }
-
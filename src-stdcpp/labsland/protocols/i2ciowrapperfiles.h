@@ -11,14 +11,18 @@
 #include <string>
 #include <thread>
 #include <atomic>
+#include <memory>
 #include "labsland/protocols.h"
+#include "bytelogfiles.h"
+#include "signalfilemonitor.h"
 
 namespace LabsLand::Protocols {
 
     /*
      * This class represents a single I2C channel (e.g., i2c0 or i2c1), relying on files and
-     * threads. Internally, once initialized, it will start running checking a file in this
-     * for inputs, and it will support calling the outputs within those callback calls.
+     * threads. Internally, once initialized, it will start a thread that blocks until the
+     * signal file is written (or signal() is called), and it will support calling the outputs
+     * within those callback calls.
      */
     class I2C_IO_WrapperFiles : public I2C_IO_Wrapper {
         private:
@@ -26,15 +30,37 @@ namespace LabsLand::Protocols {
             std::atomic<bool> continueRunning{true};
             std::string outputFileName;
             std::string inputFileName;
-            
+            // Bytes from the master, consumed in order, and bytes to the master, appended
+            InputByteLog input;
+            OutputByteLog output;
+            std::unique_ptr<SignalFileMonitor> signalMonitor;
+
+            void stopMonitoringThread();
+            void startMonitoringThread(const std::string & outputFile, const std::string & inputFile, const std::string & signalFile, const i2cSlaveCallback * callback, I2CRouter * router);
+
         public:
             I2C_IO_WrapperFiles();
             ~I2C_IO_WrapperFiles();
 
             virtual void initialize(const std::string & outputFile, const std::string & inputFile, const std::string & signalFile, const i2cSlaveCallback * callback);
 
-            virtual unsigned char readByte() override;
-            virtual void writeByte(unsigned char byte) override;
+            /*
+             * Same, but the events go to the slaves of a router (which must outlive this object).
+             */
+            virtual void initialize(const std::string & outputFile, const std::string & inputFile, const std::string & signalFile, I2CRouter * router);
+
+            virtual size_t readBytes(unsigned char * data, size_t length) override;
+            virtual size_t writeBytes(const unsigned char * data, size_t length) override;
+
+            /*
+             * Raises an event from the same process (e.g., an in-process master), without the signal file.
+             */
+            void signal(I2CEventType event);
+
+            /*
+             * Latency of the transactions handled so far.
+             */
+            SignalFileMonitor::Stats getSignalStats();
 
             bool shouldContinueRunning();
     };
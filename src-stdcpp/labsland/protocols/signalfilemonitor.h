@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LABSLAND_PROTOCOLS_SIGNAL_FILE_MONITOR_H
+#define LABSLAND_PROTOCOLS_SIGNAL_FILE_MONITOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "../utils/filewatcher.h"
+#include "../utils/eventwaiter.h"
+
+namespace LabsLand::Protocols {
+
+    /**
+     * Waits for the signals of a bus (e.g., "request" or "receive" for an I2C slave), for the thread
+     * that runs its callbacks. Signals come from a file written by the other end (watched with
+     * inotify, so a signal is seen as soon as the file is closed) or from queue() in the same process
+     * (through an eventfd). If inotify is not available, the file is polled every 100 ms.
+     *
+     * It also keeps the latency of the transactions: from the signal (the call to queue(), or the
+     * wakeup of the thread for the file) to the start of its callback, and the time the callback took.
+     */
+    class SignalFileMonitor {
+        public:
+            struct Signal {
+                std::string name;
+                uint64_t timeNs;
+                bool fromFile;
+            };
+
+            struct Stats {
+                uint64_t transactions = 0;
+                uint64_t totalDispatchNs = 0;
+                uint64_t maxDispatchNs = 0;
+                uint64_t totalHandlingNs = 0;
+                uint64_t maxHandlingNs = 0;
+
+                void print(std::ostream & output) const {
+                    output << transactions << " transactions";
+                    if (transactions > 0) {
+                        output << "; dispatch mean " << totalDispatchNs / transactions / 1000.0 << " us (max " << maxDispatchNs / 1000.0 << " us)"
+                               << "; callback mean " << totalHandlingNs / transactions / 1000.0 << " us (max " << maxHandlingNs / 1000.0 << " us)";
+                    }
+                    output << std::endl;
+                }
+            };
+
+        private:
+            const std::string signalFilename;
+            LabsLand::Utils::FileWatcher watcher;
+            bool watching;
+            int wakeFd;
+            std::atomic<bool> running = { true };
+
+            std::mutex mutex;
+            std::deque<Signal> queued;
+            Stats stats;
+
+            // Whether the file might have been written since it was last read
+            bool fileMayHaveChanged = true;
+
+            bool readSignalFile(std::string & name) {
+                int fd = open(signalFilename.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0)
+                    return false;
+                char buffer[64];
+                ssize_t length = read(fd, buffer, sizeof(buffer));
+                close(fd);
+                if (length <= 0)
+                    return false;
+                name.assign(buffer, length);
+                return true;
+            }
+
+        public:
+            static uint64_t nowNs() {
+                struct timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+            }
+
+            SignalFileMonitor(const std::string & signalFilename): signalFilename(signalFilename) {
+                watching = watcher.addFile(signalFilename);
+                wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                if (wakeFd < 0)
+                    perror("Could not create the eventfd of the signal monitor");
+            }
+
+            ~SignalFileMonitor() {
+                if (wakeFd >= 0)
+                    close(wakeFd);
+            }
+
+            SignalFileMonitor(const SignalFileMonitor &) = delete;
+            SignalFileMonitor & operator=(const SignalFileMonitor &) = delete;
+
+            /*
+             * Blocks until there is a signal. Returns false if the monitor was stopped.
+             */
+            bool wait(Signal & signal) {
+                LabsLand::Utils::EventWaiter waiter;
+                waiter.add(watching ? watcher.getFd() : -1);
+                waiter.add(wakeFd);
+
+                while (running.load()) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!queued.empty()) {
+                            signal = queued.front();
+                            queued.pop_front();
+                            return true;
+                        }
+                    }
+
+                    if (fileMayHaveChanged) {
+                        fileMayHaveChanged = !watching;
+                        if (readSignalFile(signal.name)) {
+                            signal.timeNs = nowNs();
+                            signal.fromFile = true;
+                            return true;
+                        }
+                    }
+
+                    waiter.wait(watching && wakeFd >= 0 ? -1 : 100000);
+                    if (watching && watcher.consumeEvents())
+                        fileMayHaveChanged = true;
+                    uint64_t wakeups;
+                    if (wakeFd >= 0)
+                        while (read(wakeFd, &wakeups, sizeof(wakeups)) > 0) {}
+                }
+                return false;
+            }
+
+            /*
+             * Signals from the same process, without going through the file.
+             */
+            void queue(const std::string & name) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    queued.push_back({ name, nowNs(), false });
+                }
+                uint64_t one = 1;
+                if (wakeFd >= 0 && write(wakeFd, &one, sizeof(one)) < 0)
+                    perror("Could not wake up the signal monitor");
+            }
+
+            /*
+             * Marks a signal as handled (removing the signal file, so the other end knows), and records
+             * the latency of its transaction.
+             */
+            void acknowledge(const Signal & signal, uint64_t callbackStartNs) {
+                if (signal.fromFile)
+                    remove(signalFilename.c_str());
+
+                uint64_t endNs = nowNs();
+                uint64_t dispatchNs = callbackStartNs > signal.timeNs ? callbackStartNs - signal.timeNs : 0;
+                uint64_t handlingNs = endNs - callbackStartNs;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                stats.transactions++;
+                stats.totalDispatchNs += dispatchNs;
+                stats.totalHandlingNs += handlingNs;
+                if (dispatchNs > stats.maxDispatchNs)
+                    stats.maxDispatchNs = dispatchNs;
+                if (handlingNs > stats.maxHandlingNs)
+                    stats.maxHandlingNs = handlingNs;
+            }
+
+            /*
+             * Makes wait() return false (from any thread).
+             */
+            void stop() {
+                running = false;
+                uint64_t one = 1;
+                if (wakeFd >= 0 && write(wakeFd, &one, sizeof(one)) < 0)
+                    perror("Could not wake up the signal monitor");
+            }
+
+            Stats getStats() {
+                std::lock_guard<std::mutex> lock(mutex);
+                return stats;
+            }
+
+            void resetStats() {
+                std::lock_guard<std::mutex> lock(mutex);
+                stats = Stats();
+            }
+    };
+}
+
+#endif
@@ -5,10 +5,7 @@
  * This software is licensed as described in the file LICENSE, which
  * you should have received as part of this distribution.
  */
-#include <chrono>
 #include <fstream>
-#include <vector>
-#include <sstream>
 #include <iostream>
 #include "spiiowrapperfiles.h"
 
@@ -18,8 +15,13 @@ using namespace LabsLand::Protocols;
 SPI_IO_WrapperFiles::SPI_IO_WrapperFiles() {}
 
 SPI_IO_WrapperFiles::~SPI_IO_WrapperFiles() {
+    this->stopMonitoringThread();
+}
+
+void SPI_IO_WrapperFiles::stopMonitoringThread() {
     if (this->monitoringThread) {
         this->continueRunning = false;
+        this->signalMonitor->stop();
         this->monitoringThread->join();
         delete this->monitoringThread;
         this->monitoringThread = nullptr;
@@ -27,9 +29,8 @@ SPI_IO_WrapperFiles::~SPI_IO_WrapperFiles() {
 }
 
 void runSpiThread(SPI_IO_WrapperFiles *spiInstance,
+                  SignalFileMonitor *signalMonitor,
                   const std::string &outputFile,
-                  const std::string &inputFile,
-                  const std::string &signalFile,
                   const spiSlaveCallback *callback) {
 
     if (callback == nullptr) {
@@ -37,31 +38,21 @@ void runSpiThread(SPI_IO_WrapperFiles *spiInstance,
         return;
     }
 
-    while (spiInstance->shouldContinueRunning()) {
-        this_thread::sleep_for(chrono::milliseconds(100));
+    SignalFileMonitor::Signal signal;
+    while (spiInstance->shouldContinueRunning() && signalMonitor->wait(signal)) {
+        uint64_t callbackStart = SignalFileMonitor::nowNs();
 
-        ifstream signalFileObj(signalFile);
-
-        if (!signalFileObj || !signalFileObj.good()) {
-            continue;
-        }
-
-        stringstream buffer;
-        buffer << signalFileObj.rdbuf();
-        string currentSignal = buffer.str();
-        signalFileObj.close();
-
-        if (currentSignal == "transmit") {
-            (*callback)(spiInstance, SPIEventType::slaveTransmit);
-        } else if (currentSignal == "receive") {
-            (*callback)(spiInstance, SPIEventType::slaveReceive);
-        } else if (currentSignal == "finish") {
-            (*callback)(spiInstance, SPIEventType::slaveFinish);
+        if (signal.name == "transmit") {
+            (*callback)(spiInstance, SPIEventType::spiSlaveTransmit);
+        } else if (signal.name == "receive") {
+            (*callback)(spiInstance, SPIEventType::spiSlaveReceive);
+        } else if (signal.name == "finish") {
+            (*callback)(spiInstance, SPIEventType::spiSlaveFinish);
         } else {
-            continue; // Ignore unknown or incomplete signals
+            continue; // Ignore unknown or incomplete signals (until the file is written again)
         }
 
-        remove(signalFile.c_str());
+        signalMonitor->acknowledge(signal, callbackStart);
     }
 }
 
@@ -71,59 +62,54 @@ void SPI_IO_WrapperFiles::initialize(const string &outputFile, const string &inp
     this->signalFileName = signalFile;
 
     // Clear the output file on initialization
-    ofstream newOutputFile(this->outputFileName, ios::binary | ios::trunc);
-    newOutputFile.close();
+    this->output.setFilename(this->outputFileName);
+    this->input.setFilename(this->inputFileName);
 
-    if (this->monitoringThread) {
-        this->continueRunning = false;
-        this->monitoringThread->join();
-        delete this->monitoringThread;
-        this->monitoringThread = nullptr;
-    }
+    this->stopMonitoringThread();
 
+    // The signal file is watched before the thread starts, so no signal is missed
+    this->signalMonitor.reset(new SignalFileMonitor(signalFile));
     this->continueRunning = true;
-    this->monitoringThread = new thread(runSpiThread, this, outputFile, inputFile, signalFile, callback);
+    this->monitoringThread = new thread(runSpiThread, this, this->signalMonitor.get(), outputFile, callback);
 }
 
-bool SPI_IO_WrapperFiles::shouldContinueRunning() const {
-    return this->continueRunning;
-}
-
-unsigned char SPI_IO_WrapperFiles::readByte() {
-    ifstream inputFile(this->inputFileName, ios::binary);
-    if (!inputFile || !inputFile.good()) {
-        return 0;
-    }
-
-    // Read all data into a vector
-    vector<char> buffer((istreambuf_iterator<char>(inputFile)), istreambuf_iterator<char>());
-    inputFile.close();
-
-    if (buffer.empty()) {
-        return 0;
+void SPI_IO_WrapperFiles::signal(SPIEventType event) {
+    if (!this->signalMonitor)
+        return;
+    switch (event) {
+        case SPIEventType::spiSlaveTransmit:
+            this->signalMonitor->queue("transmit");
+            break;
+        case SPIEventType::spiSlaveReceive:
+            this->signalMonitor->queue("receive");
+            break;
+        case SPIEventType::spiSlaveFinish:
+            this->signalMonitor->queue("finish");
+            break;
+        default:
+            break;
     }
+}
 
-    // Extract the first byte and remove it from the buffer
-    unsigned char firstByte = static_cast<unsigned char>(buffer[0]);
-    buffer.erase(buffer.begin());
+SignalFileMonitor::Stats SPI_IO_WrapperFiles::getSignalStats() {
+    if (!this->signalMonitor)
+        return SignalFileMonitor::Stats();
+    return this->signalMonitor->getStats();
+}
 
-    // Write the remaining buffer back to the file
-    ofstream inputFileWithoutByte(this->inputFileName, ios::binary | ios::trunc);
-    inputFileWithoutByte.write(buffer.data(), buffer.size());
-    inputFileWithoutByte.close();
+bool SPI_IO_WrapperFiles::shouldContinueRunning() const {
+    return this->continueRunning;
+}
 
-    return firstByte;
+size_t SPI_IO_WrapperFiles::readBytes(unsigned char * data, size_t length) {
+    return this->input.read(data, length);
 }
 
-void SPI_IO_WrapperFiles::writeByte(unsigned char byte) {
-    ofstream outputFile(this->outputFileName, ios::binary | ios::trunc);
-    if (!outputFile) {
-        perror("Could not open SPI output file");
-        return;
-    }
-    char byteToSend = static_cast<char>(byte);
-    outputFile.write(&byteToSend, 1);
-    outputFile.close();
+size_t SPI_IO_WrapperFiles::writeBytes(const unsigned char * data, size_t length) {
+    size_t written = this->output.write(data, length);
+    if (written < length)
+        cerr << "Could not write to the SPI output file " << this->outputFileName << endl;
+    return written;
 }
 
 void SPI_IO_WrapperFiles::setChipSelect(bool state) {
@@ -135,6 +121,4 @@ void SPI_IO_WrapperFiles::setChipSelect(bool state) {
 
     signalFile << (state ? "active" : "inactive");
     signalFile.close();
-
-    cout << "Chip select state: " << (state ? "Active" : "Inactive") << endl;
 }
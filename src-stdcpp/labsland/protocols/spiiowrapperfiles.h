@@ -11,13 +11,17 @@
 #include <string>
 #include <thread>
 #include <atomic>
+#include <memory>
 #include "labsland/protocols.h"
+#include "bytelogfiles.h"
+#include "signalfilemonitor.h"
 
 namespace LabsLand::Protocols {
 
     /*
      * This class represents a single SPI channel, relying on files and threads.
-     * Internally, it monitors the file for SPI events and triggers callbacks.
+     * Internally, a thread blocks until the signal file is written (or signal() is
+     * called) and triggers the callbacks.
      */
     class SPI_IO_WrapperFiles : public SPI_IO_Wrapper {
     private:
@@ -26,6 +30,12 @@ namespace LabsLand::Protocols {
         std::string outputFileName;
         std::string inputFileName;
         std::string signalFileName;
+        // Bytes from the master (MOSI), consumed in order, and bytes to the master (MISO), appended
+        InputByteLog input;
+        OutputByteLog output;
+        std::unique_ptr<SignalFileMonitor> signalMonitor;
+
+        void stopMonitoringThread();
 
     public:
         SPI_IO_WrapperFiles();
@@ -33,10 +43,20 @@ namespace LabsLand::Protocols {
 
         void initialize(const std::string &outputFile, const std::string &inputFile, const std::string &signalFile, const spiSlaveCallback *callback);
 
-        virtual void writeByte(unsigned char byte) override;
-        virtual unsigned char readByte() override;
+        virtual size_t writeBytes(const unsigned char * data, size_t length) override;
+        virtual size_t readBytes(unsigned char * data, size_t length) override;
         virtual void setChipSelect(bool state) override;
 
+        /*
+         * Raises an event from the same process (e.g., an in-process master), without the signal file.
+         */
+        void signal(SPIEventType event);
+
+        /*
+         * Latency of the transactions handled so far.
+         */
+        SignalFileMonitor::Stats getSignalStats();
+
         bool shouldContinueRunning() const;
     };
 
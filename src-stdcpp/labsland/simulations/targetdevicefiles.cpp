@@ -8,6 +8,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstdio>
 
 #include "targetdevicefiles.h"
 
@@ -25,7 +26,10 @@ TargetDeviceFiles::TargetDeviceFiles(
         const string & firstSignalI2cFilename,
         const string & secondOutputI2cFilename,
         const string & secondInputI2cFilename,
-        const string & secondSignalI2cFilename
+        const string & secondSignalI2cFilename,
+        const string & spiOutputFilename,
+        const string & spiInputFilename,
+        const string & spiSignalFilename
     ): 
         inputGpioFilename(inputGpioFilename), 
         outputGpioFilename(outputGpioFilename), 
@@ -36,7 +40,11 @@ TargetDeviceFiles::TargetDeviceFiles(
         firstSignalI2cFilename(firstSignalI2cFilename),
         secondOutputI2cFilename(secondOutputI2cFilename),
         secondInputI2cFilename(secondInputI2cFilename),
-        secondSignalI2cFilename(secondSignalI2cFilename)
+        secondSignalI2cFilename(secondSignalI2cFilename),
+        spiInputFilename(spiInputFilename),
+        spiOutputFilename(spiOutputFilename),
+        spiSignalFilename(spiSignalFilename),
+        asyncLog(cout)
 {}
 
 TargetDeviceFiles::~TargetDeviceFiles() {
@@ -45,9 +53,15 @@ TargetDeviceFiles::~TargetDeviceFiles() {
 
     if (this->secondI2cIoWrapper != 0)
         delete this->secondI2cIoWrapper;
+
+    if (this->spiIoWrapper != nullptr)
+        delete this->spiIoWrapper;
 }
 
 bool TargetDeviceFiles::checkSimulationSupport(shared_ptr<TargetDeviceConfiguration> configuration) {
+    // The router takes the first I2C channel
+    if (configuration->getI2CRouter() != nullptr && configuration->getFirstI2CSlaveConfig() != nullptr)
+        return false;
     return configuration->getOutputGpios() <= this->numberOfOutputs && configuration->getInputGpios() <= this->numberOfInputs;
 }
 
@@ -72,6 +86,12 @@ bool TargetDeviceFiles::initializeSimulation(shared_ptr<TargetDeviceConfiguratio
         }
         this->firstI2cIoWrapper = new I2C_IO_WrapperFiles();
         this->firstI2cIoWrapper->initialize(this->firstOutputI2cFilename, this->firstInputI2cFilename, this->firstSignalI2cFilename, configuration->getFirstI2CSlaveConfig()->getCallback());
+    } else if (configuration->getI2CRouter() != nullptr) {
+        if (this->firstI2cIoWrapper != 0) {
+            delete this->firstI2cIoWrapper;
+        }
+        this->firstI2cIoWrapper = new I2C_IO_WrapperFiles();
+        this->firstI2cIoWrapper->initialize(this->firstOutputI2cFilename, this->firstInputI2cFilename, this->firstSignalI2cFilename, configuration->getI2CRouter());
     }
 
     if (configuration->getSecondI2CSlaveConfig() != 0) {
@@ -82,6 +102,15 @@ bool TargetDeviceFiles::initializeSimulation(shared_ptr<TargetDeviceConfiguratio
         this->secondI2cIoWrapper->initialize(this->secondOutputI2cFilename, this->secondInputI2cFilename, this->secondSignalI2cFilename, configuration->getSecondI2CSlaveConfig()->getCallback());
     }
 
+    // Initialize SPI (if provided)
+    if (configuration->getSPISlaveConfig() != nullptr) {
+        if (this->spiIoWrapper != nullptr) {
+            delete this->spiIoWrapper;
+        }
+        this->spiIoWrapper = new SPI_IO_WrapperFiles();
+        this->spiIoWrapper->initialize(this->spiOutputFilename, this->spiInputFilename, this->spiSignalFilename, configuration->getSPISlaveConfig()->getCallback());
+    }
+
     return true;
 }
 
@@ -110,10 +139,21 @@ string TargetDeviceFiles::getOutputValues() {
 }
 
 ostream& TargetDeviceFiles::log() {
-    return cout;
+    return this->asyncLog.getStream();
+}
+
+bool TargetDeviceFiles::setLogFile(const string & filename) {
+    unique_ptr<ofstream> file = make_unique<ofstream>(filename, ios::app);
+    if (!file->is_open()) {
+        perror(("Could not open log file " + filename).c_str());
+        return false;
+    }
+    this->asyncLog.setDestination(move(file));
+    return true;
 }
 
 void TargetDeviceFiles::setGpio(int outputPosition, bool value) {
+    LL_PROFILE_SCOPE(this->profiler, TargetDeviceIO);
     string currentOutputs = this->getOutputValues();
     if (outputPosition > currentOutputs.size()) {
         return;
@@ -130,6 +170,7 @@ void TargetDeviceFiles::resetGpio(int outputPosition) {
 }
 
 bool TargetDeviceFiles::getGpio(int inputPosition) {
+    LL_PROFILE_SCOPE(this->profiler, TargetDeviceIO);
     ifstream ifile(this->inputGpioFilename);
     stringstream buffer;
     buffer << ifile.rdbuf();
@@ -158,3 +199,17 @@ bool TargetDeviceFiles::getGpio(NamedGpio inputPosition) {
     // TODO
     return false;
 }
+
+int TargetDeviceFiles::getInputEventFd() {
+    if (this->inputWatcher == nullptr) {
+        this->inputWatcher = make_unique<FileWatcher>();
+        this->inputWatcher->addFile(this->inputGpioFilename);
+    }
+    return this->inputWatcher->getFd();
+}
+
+bool TargetDeviceFiles::consumeInputEvents() {
+    if (this->inputWatcher == nullptr)
+        return true;
+    return this->inputWatcher->consumeEvents();
+}
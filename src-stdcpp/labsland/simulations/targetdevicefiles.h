@@ -9,7 +9,11 @@
 #define LL_TARGET_DEVICE_STD
 
 #include <string>
+#include <memory>
+#include <fstream>
 #include "labsland/simulations/targetdevice.h"
+#include "../utils/filewatcher.h"
+#include "../utils/asynclog.h"
 #include "../protocols/i2ciowrapperfiles.h"
 #include "../protocols/spiiowrapperfiles.h"
 
@@ -46,12 +50,19 @@ namespace LabsLand::Utils {
 
             LabsLand::Protocols::SPI_IO_WrapperFiles * spiIoWrapper = nullptr;
 
+            // Watch of the input GPIO file, created the first time getInputEventFd() is called
+            std::unique_ptr<FileWatcher> inputWatcher = nullptr;
+
+            // Written to the standard output (or to the file of setLogFile()) by a background thread
+            AsyncLog asyncLog;
+
         public:
             TargetDeviceFiles(
                     int numberOfOutputs, int numberOfInputs, 
                     const std::string & outputGpioFilename = "output-gpios.txt", const std::string & inputGpioFilename = "input-gpios.txt", 
                     const std::string & firstOutputI2cFilename = "output-i2c-1.txt", const std::string & firstInputI2cFilename = "input-i2c-1.txt", const std::string & firstSignalI2cFilename = "signal-i2c-1.txt",
-                    const std::string & secondOutputI2cFilename = "output-i2c-2.txt", const std::string & secondInputI2cFilename = "input-i2c-2.txt", const std::string & secondSignalI2cFilename = "signal-i2c-2.txt"
+                    const std::string & secondOutputI2cFilename = "output-i2c-2.txt", const std::string & secondInputI2cFilename = "input-i2c-2.txt", const std::string & secondSignalI2cFilename = "signal-i2c-2.txt",
+                    const std::string & spiOutputFilename = "output-spi.txt", const std::string & spiInputFilename = "input-spi.txt", const std::string & spiSignalFilename = "signal-spi.txt"
             );
             ~TargetDeviceFiles();
 
@@ -78,6 +89,12 @@ namespace LabsLand::Utils {
             virtual bool initializeCustomSerial();
 
             virtual std::ostream& log();
+            using TargetDevice::log;
+
+            /*
+             * Sends the log to a file (e.g., when several simulations run in the same process).
+             */
+            bool setLogFile(const std::string & filename);
 
             // Add other protocols in the future
 
@@ -99,13 +116,10 @@ namespace LabsLand::Utils {
             virtual bool getGpio(LabsLand::Protocols::NamedGpio inputPosition);
 
             /**
-             * SPI-specific functionality
+             * Readable when the input GPIO file is written.
              */
-            /*
-            virtual void spiWriteByte(unsigned char byte);
-            virtual unsigned char spiReadByte();
-            virtual void setSpiChipSelect(bool state);
-            */
+            virtual int getInputEventFd();
+            virtual bool consumeInputEvents();
     };
 }
 
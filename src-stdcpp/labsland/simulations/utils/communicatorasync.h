@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef SIMULATION_COMMUNICATIONS_ASYNC_H
+#define SIMULATION_COMMUNICATIONS_ASYNC_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <cstdint>
+#include <iostream>
+
+#include <semaphore.h>
+
+#include "labsland/simulations/utils/communicator.h"
+
+namespace LabsLand::Simulations::Utils {
+
+    /*
+     * Statistics of a SimulationCommunicatorAsync, in microseconds.
+     */
+    struct AsyncReportStats {
+        // Reports handed off by the simulation and reports actually published (older
+        // reports still pending when a newer one arrives are skipped)
+        uint64_t handedOff = 0;
+        uint64_t published = 0;
+        // Time that sendReport() took in the simulation thread (copying the state)
+        double maxHandOffUs = 0;
+        // Time that sendReport() of the wrapped communicator took in the publisher thread:
+        // the stall the simulation would have had without this communicator
+        double maxPublishUs = 0;
+        double totalPublishUs = 0;
+    };
+
+    /*
+     * Wraps another communicator so reports are serialized and published by a dedicated
+     * thread. sendReport() only copies the report into a triple buffer and wakes up the
+     * publisher thread, so the simulation never waits for the serialization or the I/O
+     * of the wrapped communicator (e.g., writing a file).
+     *
+     * The triple buffer has a slot being written by the simulation, one being read by the
+     * publisher and the latest report handed off, which are swapped atomically. If the
+     * publisher is slower than the simulation, intermediate reports are skipped (which is
+     * fine, since reports contain the full state).
+     *
+     * readRequest() is forwarded to the wrapped communicator in the calling thread, so the
+     * wrapped communicator must support readRequest() and sendReport() being called from
+     * different threads (the files, socket and shared memory ones do).
+     */
+    template <class OutputDataType, class InputDataType>
+    class SimulationCommunicatorAsync: public SimulationCommunicator<OutputDataType, InputDataType>
+    {
+        private:
+            typedef std::chrono::steady_clock Clock;
+
+            // Bit set in latestSlot when it contains a report not read by the publisher yet
+            static constexpr uint32_t FRESH = 4;
+
+            std::shared_ptr<SimulationCommunicator<OutputDataType, InputDataType>> communicator;
+
+            OutputDataType slots[3];
+            uint32_t writeSlot = 0;                      // only used by the simulation thread
+            uint32_t readSlot = 1;                       // only used by the publisher thread
+            std::atomic<uint32_t> latestSlot = { 2 };    // exchanged by both
+
+            sem_t reportsAvailable;
+            std::atomic<bool> running = { true };
+            std::thread publisher;
+
+            // Written by the simulation thread
+            uint64_t handedOff = 0;
+            double maxHandOffUs = 0;
+            // Written by the publisher thread
+            std::atomic<uint64_t> published = { 0 };
+            std::atomic<double> maxPublishUs = { 0 };
+            std::atomic<double> totalPublishUs = { 0 };
+            std::atomic<uint64_t> reportSequence = { 0 };
+
+            static double elapsedUs(Clock::time_point since) {
+                return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+            }
+
+            /*
+             * Publishes the latest report, if the publisher did not read it yet.
+             */
+            void publishFreshReport() {
+                if ((latestSlot.load(std::memory_order_acquire) & FRESH) == 0)
+                    return;
+
+                readSlot = latestSlot.exchange(readSlot, std::memory_order_acq_rel) & ~FRESH;
+
+                Clock::time_point start = Clock::now();
+                communicator->sendReport(slots[readSlot]);
+                double publishUs = elapsedUs(start);
+                reportSequence.store(communicator->getReportSequence(), std::memory_order_relaxed);
+
+                published.fetch_add(1, std::memory_order_relaxed);
+                totalPublishUs.store(totalPublishUs.load(std::memory_order_relaxed) + publishUs, std::memory_order_relaxed);
+                if (publishUs > maxPublishUs.load(std::memory_order_relaxed))
+                    maxPublishUs.store(publishUs, std::memory_order_relaxed);
+            }
+
+            void publishReports() {
+                while (true) {
+                    while (sem_wait(&reportsAvailable) != 0) {}
+
+                    publishFreshReport();
+
+                    if (!running.load(std::memory_order_acquire)) {
+                        // A report handed off while the previous one was being published (before the
+                        // destructor) has not been consumed by the wait above yet
+                        publishFreshReport();
+                        return;
+                    }
+                }
+            }
+
+        public:
+            SimulationCommunicatorAsync(std::shared_ptr<SimulationCommunicator<OutputDataType, InputDataType>> communicator): communicator(communicator) {
+                sem_init(&reportsAvailable, 0, 0);
+                publisher = std::thread(&SimulationCommunicatorAsync::publishReports, this);
+            }
+
+            /*
+             * Publishes the last report handed off (if it was not yet) and stops the publisher thread.
+             */
+            ~SimulationCommunicatorAsync() {
+                running.store(false, std::memory_order_release);
+                sem_post(&reportsAvailable);
+                publisher.join();
+                sem_destroy(&reportsAvailable);
+            }
+
+            bool readRequest(InputDataType & request) {
+                return communicator->readRequest(request);
+            }
+
+            size_t readRequests(InputDataType * requests, size_t maxRequests) {
+                return communicator->readRequests(requests, maxRequests);
+            }
+
+            /**
+             * Copies the report and hands it off to the publisher thread, which will send it
+             * through the wrapped communicator.
+             */
+            void sendReport(OutputDataType & report) {
+                Clock::time_point start = Clock::now();
+
+                slots[writeSlot] = report;
+                writeSlot = latestSlot.exchange(writeSlot | FRESH, std::memory_order_acq_rel) & ~FRESH;
+                sem_post(&reportsAvailable);
+
+                handedOff++;
+                double handOffUs = elapsedUs(start);
+                if (handOffUs > maxHandOffUs)
+                    maxHandOffUs = handOffUs;
+            }
+
+            /*
+             * Sequence of the wrapped communicator after the last report published, which
+             * might lag behind the reports handed off.
+             */
+            uint64_t getReportSequence() const override {
+                return reportSequence.load(std::memory_order_relaxed);
+            }
+
+            uint64_t getReportAcknowledgements() override {
+                return communicator->getReportAcknowledgements();
+            }
+
+            bool supportsReportAcknowledgements() const override {
+                return communicator->supportsReportAcknowledgements();
+            }
+
+            int getRequestEventFd() override {
+                return communicator->getRequestEventFd();
+            }
+
+            bool consumeRequestEvents() override {
+                return communicator->consumeRequestEvents();
+            }
+
+            /*
+             * Must be called from the simulation thread (the thread calling sendReport()).
+             */
+            AsyncReportStats getStats() const {
+                AsyncReportStats stats;
+                stats.handedOff = handedOff;
+                stats.maxHandOffUs = maxHandOffUs;
+                stats.published = published.load(std::memory_order_relaxed);
+                stats.maxPublishUs = maxPublishUs.load(std::memory_order_relaxed);
+                stats.totalPublishUs = totalPublishUs.load(std::memory_order_relaxed);
+                return stats;
+            }
+
+            void printStats(std::ostream & output) const {
+                AsyncReportStats stats = getStats();
+                output << "Async reports: " << stats.handedOff << " handed off, " << stats.published << " published; "
+                       << "max hand-off " << stats.maxHandOffUs << " us, "
+                       << "max publish " << stats.maxPublishUs << " us (stall avoided), "
+                       << "mean publish " << (stats.published > 0 ? stats.totalPublishUs / stats.published : 0) << " us" << std::endl;
+            }
+    };
+
+}
+
+#endif
@@ -9,10 +9,24 @@
 #define SIMULATION_COMMUNICATIONS_FILES_H
 
 #include <string>
+#include <string_view>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <functional>
+#include <memory>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 
 #include "labsland/simulations/utils/communicator.h"
+#include "../../utils/filewatcher.h"
 
 namespace LabsLand::Simulations::Utils {
 
@@ -22,47 +36,288 @@ namespace LabsLand::Simulations::Utils {
         private:
             const std::string inputFilename;
             const std::string outputFilename;
+
+            // Sequence number of the last report published in outputFilename (0 if none yet)
+            uint64_t reportSequence = 0;
+
+            // Hash and size of the last report published, to skip rewriting identical reports
+            size_t lastReportHash = 0;
+            size_t lastReportSize = 0;
+            // Reused between reports, so serializing them does not allocate
+            std::vector<char> reportBuffer = std::vector<char>(4096);
+            bool reportPublished = false;
+
+            // Offset in inputFilename of the next message to read (persisted in inputOffsetFilename)
+            const std::string inputOffsetFilename;
+            // Counter written by the web server each time it reads a report
+            const std::string acknowledgementsFilename;
+            uint64_t reportAcknowledgements = 0;
+            off_t inputOffset = 0;
+
+            // Watch of inputFilename, created the first time getRequestEventFd() is called
+            std::unique_ptr<LabsLand::Utils::FileWatcher> requestWatcher = nullptr;
+
+            void storeInputOffset() {
+                std::string temporaryFilename = inputOffsetFilename + ".tmp";
+                std::ofstream ofile(temporaryFilename, std::ios::trunc);
+                if (!ofile.is_open())
+                    return;
+                ofile << inputOffset;
+                ofile.close();
+                if (ofile)
+                    std::rename(temporaryFilename.c_str(), inputOffsetFilename.c_str());
+            }
+
+            /*
+             * Truncates the input log once all of its messages have been consumed. The server
+             * appends under the same lock, so no message can be appended in between.
+             */
+            void compactInputLog() {
+                int fd = open(inputFilename.c_str(), O_RDWR | O_CLOEXEC);
+                if (fd < 0)
+                    return;
+                if (flock(fd, LOCK_EX) != 0) {
+                    close(fd);
+                    return;
+                }
+
+                struct stat status;
+                if (fstat(fd, &status) == 0 && status.st_size == inputOffset && ftruncate(fd, 0) == 0) {
+                    inputOffset = 0;
+                    storeInputOffset();
+                }
+                flock(fd, LOCK_UN);
+                close(fd);
+            }
+
+            /*
+             * Pops the next complete message of the input log, if any.
+             */
+            bool popRequestMessage(std::string & message) {
+                // Read-only, so reading does not look like a write to watchers of the file (see getRequestEventFd())
+                int fd = open(inputFilename.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0)
+                    return false;
+
+                struct stat status;
+                if (fstat(fd, &status) != 0) {
+                    close(fd);
+                    return false;
+                }
+
+                // The log was truncated or replaced under us: start from the beginning
+                if (status.st_size < inputOffset) {
+                    inputOffset = 0;
+                    storeInputOffset();
+                }
+
+                if (status.st_size == inputOffset) {
+                    close(fd);
+                    if (inputOffset > 0)
+                        compactInputLog();
+                    return false;
+                }
+
+                // Header: "<length>:"
+                char header[24];
+                ssize_t headerSize = pread(fd, header, sizeof(header), inputOffset);
+                if (headerSize <= 0) {
+                    // Failed read (e.g., EINTR): try again later, without losing the queued requests
+                    close(fd);
+                    return false;
+                }
+                size_t length = 0;
+                ssize_t position = 0;
+                while (position < headerSize && header[position] >= '0' && header[position] <= '9') {
+                    length = length * 10 + (header[position] - '0');
+                    position++;
+                }
+
+                if (position == headerSize) {
+                    // The header is still being appended
+                    close(fd);
+                    return false;
+                }
+
+                if (position == 0 || header[position] != ':') {
+                    std::cerr << "Corrupted message log " << inputFilename << " at offset " << inputOffset << "; skipping it" << std::endl;
+                    inputOffset = status.st_size;
+                    storeInputOffset();
+                    close(fd);
+                    return false;
+                }
+
+                off_t messageOffset = inputOffset + position + 1;
+                if (messageOffset + (off_t)length > status.st_size) {
+                    // The message is still being appended
+                    close(fd);
+                    return false;
+                }
+
+                message.resize(length);
+                if (length > 0 && pread(fd, &message[0], length, messageOffset) != (ssize_t)length) {
+                    close(fd);
+                    return false;
+                }
+                close(fd);
+
+                inputOffset = messageOffset + length;
+                storeInputOffset();
+                return true;
+            }
+
+            /*
+             * Reads the sequence number of a report published by a previous run (if any),
+             * so the sequence keeps growing across restarts of the simulation.
+             */
+            uint64_t readPublishedSequence() {
+                std::ifstream ifile(outputFilename);
+                uint64_t sequence = 0;
+                if (ifile.is_open() && (ifile >> sequence) && ifile.peek() == '\n')
+                    return sequence;
+                return 0;
+            }
+
         public:
 
-            SimulationCommunicatorFiles(std::string outputFilename, std::string inputFilename): outputFilename(outputFilename), inputFilename(inputFilename) {}
+            SimulationCommunicatorFiles(std::string outputFilename, std::string inputFilename): outputFilename(outputFilename), inputFilename(inputFilename), inputOffsetFilename(inputFilename + ".offset"), acknowledgementsFilename(outputFilename + ".ack") {
+                reportSequence = readPublishedSequence();
+
+                std::ifstream offsetFile(inputOffsetFilename);
+                if (!(offsetFile >> inputOffset))
+                    inputOffset = 0;
+            }
 
             /*
              * Receive data from the user interface (web browser). 
              *
-             * In this implementation, we use a file to handle this information,
-             * where we are constantly reading data from disk.
+             * In this implementation, the input file is an append-only log of
+             * length-prefixed messages ("<length>:<message>" one after the other)
+             * that the server appends to. Messages are popped in order, and the
+             * offset of the next message to read is stored in "<inputFilename>.offset"
+             * so a restarted simulation does not process them again. Once every
+             * message has been consumed, the log is truncated.
              *
-             * It returns true if something was ready into the structure.
+             * It returns true if something was ready into the structure. Messages
+             * that cannot be deserialized are skipped.
              */
             bool readRequest(InputDataType & request) { 
-                std::ifstream ifile(inputFilename);
-                if (ifile.is_open()) {
-                    std::stringstream buffer;
-                    buffer << ifile.rdbuf();
-                    if (!ifile) {
-                        ifile.close();
-                        return false;
-                    }
-
-                    std::string serialized = buffer.str();
-                    return request.deserialize(serialized);
+                std::string message;
+                while (popRequestMessage(message)) {
+                    if (request.deserialize(message))
+                        return true;
                 }
                 return false;
             }
-          
             /**
              * Update latest data so the user interface (web browser) receives it. 
              *
-             * In this implementation, we use a filen to handle this information,
-             * writing the information into disk.
+             * In this implementation, we use a file to handle this information,
+             * writing the information into disk. The file contains a first line with
+             * the sequence number of the report and then the serialized report:
+             *
+             *    <sequence>\n<report>
+             *
+             * The report is written to a temporary file that is then renamed over the
+             * output file, so readers never see a partially written report. If the report
+             * is identical to the last one published, nothing is written.
              */
             void sendReport(OutputDataType & report) {
-                std::ofstream ofile(outputFilename);
+                size_t length;
+                {
+                    LL_PROFILE_SCOPE(this->profiler, Serialization);
+                    length = report.serializeTo(reportBuffer.data(), reportBuffer.size());
+                    if (length > reportBuffer.size()) {
+                        reportBuffer.resize(length);
+                        report.serializeTo(reportBuffer.data(), reportBuffer.size());
+                    }
+                }
+                std::string_view serialized(reportBuffer.data(), length);
+                size_t serializedHash = std::hash<std::string_view>()(serialized);
+                if (reportPublished && serializedHash == lastReportHash && serialized.size() == lastReportSize)
+                    return;
+
+                std::string temporaryFilename = outputFilename + ".tmp";
+                std::ofstream ofile(temporaryFilename, std::ios::trunc);
                 if (!ofile.is_open())
                     return;
 
-                ofile << report.serialize();
+                ofile << (reportSequence + 1) << '\n';
+                ofile.write(serialized.data(), serialized.size());
                 ofile.close();
+                if (!ofile)
+                    return;
+
+                if (std::rename(temporaryFilename.c_str(), outputFilename.c_str()) != 0) {
+                    perror("Could not publish simulation report");
+                    return;
+                }
+
+                reportSequence++;
+                lastReportHash = serializedHash;
+                lastReportSize = serialized.size();
+                reportPublished = true;
+            }
+
+            /**
+             * Sequence number of the last report published (0 if none was published yet).
+             */
+            uint64_t getReportSequence() const override {
+                return reportSequence;
+            }
+
+            /**
+             * Read acknowledgements, from the "<output file>.ack" file, which the web server
+             * rewrites with an increasing counter each time it reads the output file. If the
+             * file cannot be read (e.g., while it is being rewritten), the last value is kept.
+             */
+            uint64_t getReportAcknowledgements() override {
+                int fd = open(acknowledgementsFilename.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0)
+                    return reportAcknowledgements;
+
+                char buffer[32];
+                ssize_t length = pread(fd, buffer, sizeof(buffer) - 1, 0);
+                close(fd);
+                if (length <= 0)
+                    return reportAcknowledgements;
+
+                buffer[length] = '\0';
+                char * end = nullptr;
+                unsigned long long acknowledgements = strtoull(buffer, &end, 10);
+                if (end != buffer)
+                    reportAcknowledgements = acknowledgements;
+                return reportAcknowledgements;
+            }
+
+            bool supportsReportAcknowledgements() const override {
+                return true;
+            }
+
+            /**
+             * Readable when the input file is written: when the server appends to it, and also when
+             * compactInputLog() truncates it (consumeRequestEvents() ignores the latter).
+             */
+            int getRequestEventFd() override {
+                if (requestWatcher == nullptr) {
+                    requestWatcher = std::make_unique<LabsLand::Utils::FileWatcher>();
+                    requestWatcher->addFile(inputFilename);
+                }
+                return requestWatcher->getFd();
+            }
+
+            bool consumeRequestEvents() override {
+                if (requestWatcher == nullptr)
+                    return true;
+                if (!requestWatcher->consumeEvents())
+                    return false;
+
+                // The write may be our own truncation of the log once it was drained: only wake up the
+                // simulation if there is something after the consumed messages
+                struct stat status;
+                if (stat(inputFilename.c_str(), &status) != 0)
+                    return true;
+                return status.st_size != inputOffset;
             }
     };
 
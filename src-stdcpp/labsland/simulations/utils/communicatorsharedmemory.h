@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef SIMULATION_COMMUNICATIONS_SHARED_MEMORY_H
+#define SIMULATION_COMMUNICATIONS_SHARED_MEMORY_H
+
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <functional>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "labsland/simulations/utils/communicator.h"
+
+namespace LabsLand::Simulations::Utils {
+
+    /*
+     * Layout of the shared memory channel (all offsets in bytes, little endian):
+     *
+     *   [0, 64)        SharedMemoryChannelHeader
+     *   3 report slots, each: SharedMemoryReportSlotHeader (16 bytes) + reportSlotSize bytes
+     *   requestSlots request slots, each: uint32 size + uint32 reserved + requestSlotSize bytes
+     *
+     * Reports are a triple buffer: the simulation writes the new report in a slot other than
+     * the latest one and then publishes its index in latestReportSlot, so it never waits for
+     * readers. Each slot has a sequence that is odd while the slot is being written: readers
+     * copy the latest slot and retry if its sequence changed meanwhile (which only happens if
+     * the reader is slower than two reports in a row). No locks are taken on either side.
+     *
+     * Requests are a single-producer (the peer) single-consumer (the simulation) ring: the
+     * peer writes in requestHead and the simulation reads from requestTail. If the ring is
+     * full, the peer's request is rejected.
+     *
+     * The header is: magic @0, version @4, reportSlotSize @8, requestSlotSize @12, requestSlots @16,
+     * latestReportSlot @20, reportSequence @24, requestHead @32, requestTail @36 and
+     * reportAcknowledgements @40, a counter the peer bumps each time the web server reads a report.
+     */
+    const uint32_t SHARED_MEMORY_MAGIC = 0x4d534c4c; // "LLSM"
+    const uint32_t SHARED_MEMORY_VERSION = 1;
+    const uint32_t SHARED_MEMORY_NO_REPORT = 0xFFFFFFFF;
+    const uint32_t SHARED_MEMORY_REPORT_SLOTS = 3;
+    const uint32_t SHARED_MEMORY_HEADER_SIZE = 64;
+
+    struct SharedMemoryChannelHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t reportSlotSize;
+        uint32_t requestSlotSize;
+        uint32_t requestSlots;
+        std::atomic<uint32_t> latestReportSlot;
+        std::atomic<uint64_t> reportSequence;
+        std::atomic<uint32_t> requestHead;
+        std::atomic<uint32_t> requestTail;
+        std::atomic<uint64_t> reportAcknowledgements;
+    };
+
+    struct SharedMemoryReportSlotHeader {
+        std::atomic<uint64_t> sequence;
+        uint32_t size;
+        uint32_t reserved;
+    };
+
+    struct SharedMemoryRequestSlotHeader {
+        uint32_t size;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(SharedMemoryChannelHeader) <= SHARED_MEMORY_HEADER_SIZE, "SharedMemoryChannelHeader does not fit");
+    static_assert(sizeof(SharedMemoryReportSlotHeader) == 16, "Unexpected SharedMemoryReportSlotHeader layout");
+    static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "Shared memory atomics must be lock free");
+
+    /*
+     * A mapping of the channel, shared by the simulation side and the peer side.
+     */
+    class SharedMemoryChannel {
+        private:
+            std::string name;
+            bool owner = false;
+            size_t mappingSize = 0;
+            char * mapping = nullptr;
+
+            static size_t computeSize(uint32_t reportSlotSize, uint32_t requestSlotSize, uint32_t requestSlots) {
+                return SHARED_MEMORY_HEADER_SIZE
+                    + SHARED_MEMORY_REPORT_SLOTS * (sizeof(SharedMemoryReportSlotHeader) + reportSlotSize)
+                    + requestSlots * (sizeof(SharedMemoryRequestSlotHeader) + requestSlotSize);
+            }
+
+        public:
+            SharedMemoryChannel() = default;
+            SharedMemoryChannel(const SharedMemoryChannel &) = delete;
+            SharedMemoryChannel & operator=(const SharedMemoryChannel &) = delete;
+
+            ~SharedMemoryChannel() {
+                if (mapping != nullptr)
+                    munmap(mapping, mappingSize);
+                if (owner)
+                    shm_unlink(name.c_str());
+            }
+
+            /*
+             * Creates (or replaces) the channel. Used by the simulation.
+             */
+            bool create(const std::string & name, uint32_t reportSlotSize, uint32_t requestSlotSize, uint32_t requestSlots) {
+                this->name = name;
+                shm_unlink(name.c_str());
+                int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+                if (fd < 0) {
+                    perror("Could not create shared memory channel");
+                    return false;
+                }
+
+                mappingSize = computeSize(reportSlotSize, requestSlotSize, requestSlots);
+                if (ftruncate(fd, mappingSize) != 0) {
+                    perror("Could not size shared memory channel");
+                    close(fd);
+                    shm_unlink(name.c_str());
+                    return false;
+                }
+
+                void * address = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                close(fd);
+                if (address == MAP_FAILED) {
+                    perror("Could not map shared memory channel");
+                    shm_unlink(name.c_str());
+                    return false;
+                }
+
+                owner = true;
+                mapping = (char *)address;
+
+                // ftruncate filled it with zeros, so every slot sequence starts at 0
+                SharedMemoryChannelHeader * channelHeader = new (mapping) SharedMemoryChannelHeader();
+                channelHeader->reportSlotSize = reportSlotSize;
+                channelHeader->requestSlotSize = requestSlotSize;
+                channelHeader->requestSlots = requestSlots;
+                channelHeader->latestReportSlot.store(SHARED_MEMORY_NO_REPORT);
+                channelHeader->reportSequence.store(0);
+                channelHeader->requestHead.store(0);
+                channelHeader->requestTail.store(0);
+                channelHeader->version = SHARED_MEMORY_VERSION;
+                std::atomic_thread_fence(std::memory_order_release);
+                channelHeader->magic = SHARED_MEMORY_MAGIC;
+                return true;
+            }
+
+            /*
+             * Opens a channel created by the simulation. Used by the peer.
+             */
+            bool open(const std::string & name) {
+                this->name = name;
+                int fd = shm_open(name.c_str(), O_RDWR, 0);
+                if (fd < 0)
+                    return false;
+
+                struct stat status;
+                if (fstat(fd, &status) != 0 || (size_t)status.st_size < SHARED_MEMORY_HEADER_SIZE) {
+                    close(fd);
+                    return false;
+                }
+
+                mappingSize = status.st_size;
+                void * address = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                close(fd);
+                if (address == MAP_FAILED)
+                    return false;
+
+                mapping = (char *)address;
+                if (header()->magic != SHARED_MEMORY_MAGIC || header()->version != SHARED_MEMORY_VERSION ||
+                        computeSize(header()->reportSlotSize, header()->requestSlotSize, header()->requestSlots) > mappingSize) {
+                    munmap(mapping, mappingSize);
+                    mapping = nullptr;
+                    return false;
+                }
+                return true;
+            }
+
+            bool isOpen() const {
+                return mapping != nullptr;
+            }
+
+            SharedMemoryChannelHeader * header() const {
+                return (SharedMemoryChannelHeader *)mapping;
+            }
+
+            SharedMemoryReportSlotHeader * reportSlot(uint32_t index) const {
+                size_t offset = SHARED_MEMORY_HEADER_SIZE + index * (sizeof(SharedMemoryReportSlotHeader) + header()->reportSlotSize);
+                return (SharedMemoryReportSlotHeader *)(mapping + offset);
+            }
+
+            SharedMemoryRequestSlotHeader * requestSlot(uint32_t index) const {
+                size_t offset = SHARED_MEMORY_HEADER_SIZE
+                    + SHARED_MEMORY_REPORT_SLOTS * (sizeof(SharedMemoryReportSlotHeader) + header()->reportSlotSize)
+                    + (index % header()->requestSlots) * (sizeof(SharedMemoryRequestSlotHeader) + header()->requestSlotSize);
+                return (SharedMemoryRequestSlotHeader *)(mapping + offset);
+            }
+
+            static char * data(SharedMemoryReportSlotHeader * slot) {
+                return (char *)(slot + 1);
+            }
+
+            static char * data(SharedMemoryRequestSlotHeader * slot) {
+                return (char *)(slot + 1);
+            }
+    };
+
+    /*
+     * Communicator through a shared memory channel (see SharedMemoryChannel), meant for the
+     * simulations that report at the highest rates. sendReport() never blocks on the peer:
+     * it copies the serialized report into a free slot of the triple buffer, and readRequest()
+     * pops requests from the ring without any system call.
+     */
+    template <class OutputDataType, class InputDataType>
+    class SimulationCommunicatorSharedMemory: public SimulationCommunicator<OutputDataType, InputDataType>
+    {
+        private:
+            SharedMemoryChannel channel;
+
+            size_t lastReportHash = 0;
+            size_t lastReportSize = 0;
+            std::vector<char> reportBuffer;
+
+        public:
+
+            SimulationCommunicatorSharedMemory(const std::string & name, uint32_t reportSlotSize = 4096, uint32_t requestSlotSize = 2048, uint32_t requestSlots = 64) {
+                channel.create(name, reportSlotSize, requestSlotSize, requestSlots);
+            }
+
+            /*
+             * Receive data from the user interface (web browser).
+             *
+             * In this implementation, requests are popped in order from the request ring.
+             *
+             * It returns true if something was ready into the structure. Requests that cannot
+             * be deserialized are skipped.
+             */
+            bool readRequest(InputDataType & request) {
+                if (!channel.isOpen())
+                    return false;
+
+                SharedMemoryChannelHeader * header = channel.header();
+                uint32_t tail = header->requestTail.load(std::memory_order_relaxed);
+                while (tail != header->requestHead.load(std::memory_order_acquire)) {
+                    SharedMemoryRequestSlotHeader * slot = channel.requestSlot(tail);
+                    uint32_t size = slot->size <= header->requestSlotSize ? slot->size : header->requestSlotSize;
+                    std::string serialized(SharedMemoryChannel::data(slot), size);
+
+                    tail++;
+                    header->requestTail.store(tail, std::memory_order_release);
+
+                    if (request.deserialize(serialized))
+                        return true;
+                }
+                return false;
+            }
+
+            /**
+             * Update latest data so the user interface (web browser) receives it.
+             *
+             * In this implementation, the report is copied into the next slot of the triple
+             * buffer and published, unless it is identical to the last report. Reports that
+             * do not fit in a slot are dropped.
+             */
+            void sendReport(OutputDataType & report) {
+                if (!channel.isOpen())
+                    return;
+
+                SharedMemoryChannelHeader * header = channel.header();
+                reportBuffer.resize(header->reportSlotSize);
+                size_t length;
+                {
+                    LL_PROFILE_SCOPE(this->profiler, Serialization);
+                    length = report.serializeTo(reportBuffer.data(), reportBuffer.size());
+                }
+                if (length > reportBuffer.size()) {
+                    std::cerr << "Report of " << length << " bytes does not fit in the shared memory slots" << std::endl;
+                    return;
+                }
+
+                std::string_view serialized(reportBuffer.data(), length);
+                size_t serializedHash = std::hash<std::string_view>()(serialized);
+                uint64_t reportSequence = header->reportSequence.load(std::memory_order_relaxed);
+                if (reportSequence > 0 && serializedHash == lastReportHash && serialized.size() == lastReportSize)
+                    return;
+
+                uint32_t latest = header->latestReportSlot.load(std::memory_order_relaxed);
+                uint32_t next = latest == SHARED_MEMORY_NO_REPORT ? 0 : (latest + 1) % SHARED_MEMORY_REPORT_SLOTS;
+                SharedMemoryReportSlotHeader * slot = channel.reportSlot(next);
+
+                uint64_t slotSequence = slot->sequence.load(std::memory_order_relaxed);
+                slot->sequence.store(slotSequence + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                memcpy(SharedMemoryChannel::data(slot), serialized.data(), serialized.size());
+                slot->size = serialized.size();
+                slot->sequence.store(slotSequence + 2, std::memory_order_release);
+
+                header->latestReportSlot.store(next, std::memory_order_release);
+                header->reportSequence.store(reportSequence + 1, std::memory_order_release);
+
+                lastReportHash = serializedHash;
+                lastReportSize = serialized.size();
+            }
+
+            /**
+             * Sequence number of the last report published (0 if none was published yet).
+             */
+            uint64_t getReportSequence() const override {
+                return channel.isOpen() ? channel.header()->reportSequence.load(std::memory_order_relaxed) : 0;
+            }
+
+            uint64_t getReportAcknowledgements() override {
+                return channel.isOpen() ? channel.header()->reportAcknowledgements.load(std::memory_order_relaxed) : 0;
+            }
+
+            bool supportsReportAcknowledgements() const override {
+                return true;
+            }
+    };
+
+    /*
+     * Peer side of SimulationCommunicatorSharedMemory, standing in for the web server (e.g.,
+     * in benchmarks or to drive a simulation from another program).
+     */
+    class SimulationCommunicatorSharedMemoryPeer {
+        private:
+            SharedMemoryChannel channel;
+
+        public:
+            bool connectTo(const std::string & name) {
+                return channel.open(name);
+            }
+
+            /*
+             * Copies the newest complete report. Returns false if there is none yet.
+             */
+            bool readLatestReport(std::string & report, uint64_t * reportSequence = nullptr) {
+                if (!channel.isOpen())
+                    return false;
+
+                SharedMemoryChannelHeader * header = channel.header();
+                while (true) {
+                    uint64_t sequence = header->reportSequence.load(std::memory_order_acquire);
+                    uint32_t latest = header->latestReportSlot.load(std::memory_order_acquire);
+                    if (latest >= SHARED_MEMORY_REPORT_SLOTS)
+                        return false;
+
+                    SharedMemoryReportSlotHeader * slot = channel.reportSlot(latest);
+                    uint64_t slotSequence = slot->sequence.load(std::memory_order_acquire);
+                    if (slotSequence % 2 != 0)
+                        continue;
+
+                    uint32_t size = slot->size <= header->reportSlotSize ? slot->size : header->reportSlotSize;
+                    report.assign(SharedMemoryChannel::data(slot), size);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (slot->sequence.load(std::memory_order_relaxed) == slotSequence) {
+                        if (reportSequence != nullptr)
+                            *reportSequence = sequence;
+                        return true;
+                    }
+                }
+            }
+
+            /*
+             * Queues a request. Returns false if it does not fit or the ring is full.
+             */
+            bool sendRequest(const std::string & request) {
+                if (!channel.isOpen())
+                    return false;
+
+                SharedMemoryChannelHeader * header = channel.header();
+                if (request.size() > header->requestSlotSize)
+                    return false;
+
+                uint32_t head = header->requestHead.load(std::memory_order_relaxed);
+                if (head - header->requestTail.load(std::memory_order_acquire) >= header->requestSlots)
+                    return false;
+
+                SharedMemoryRequestSlotHeader * slot = channel.requestSlot(head);
+                memcpy(SharedMemoryChannel::data(slot), request.data(), request.size());
+                slot->size = request.size();
+                header->requestHead.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+            /*
+             * Tells the simulation that a report was read (see getReportAcknowledgements()).
+             */
+            void acknowledgeReport() {
+                if (channel.isOpen())
+                    channel.header()->reportAcknowledgements.fetch_add(1, std::memory_order_relaxed);
+            }
+    };
+
+}
+
+#endif
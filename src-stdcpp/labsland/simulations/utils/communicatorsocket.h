@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef SIMULATION_COMMUNICATIONS_SOCKET_H
+#define SIMULATION_COMMUNICATIONS_SOCKET_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "labsland/simulations/utils/communicator.h"
+
+namespace LabsLand::Simulations::Utils {
+
+    // Maximum size of a single message (request or report) through the socket
+    const size_t SOCKET_MAX_MESSAGE_SIZE = 64 * 1024;
+
+    // First byte of the packets the peer sends to acknowledge it read a report (requests never start with it)
+    const char SOCKET_ACKNOWLEDGEMENT_MARK = '\0';
+
+    /*
+     * Fills a sockaddr_un with the path. Returns false if the path does not fit.
+     */
+    inline bool fillUnixSocketAddress(const std::string & socketPath, struct sockaddr_un & address) {
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path))
+            return false;
+        strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+        return true;
+    }
+
+    /*
+     * Communicator over a SOCK_SEQPACKET Unix domain socket. The simulation listens in
+     * socketPath and a single peer (e.g., the web server) connects to it. Each packet is
+     * a full message: requests from the peer and reports to the peer.
+     *
+     * Nothing blocks: requests are read with non-blocking reads and reports are pushed
+     * to the peer the moment they are sent. If the peer does not keep up and its buffer
+     * is full, reports are dropped (the peer only cares about the latest one anyway).
+     * When a peer connects, it immediately receives the last report.
+     */
+    template <class OutputDataType, class InputDataType>
+    class SimulationCommunicatorSocket: public SimulationCommunicator<OutputDataType, InputDataType>
+    {
+        private:
+            const std::string socketPath;
+            int listeningSocket = -1;
+            int peerSocket = -1;
+            // Epoll instance with the listening socket and the peer, created by getRequestEventFd()
+            int requestEvents = -1;
+            // readRequest() and sendReport() may be called from different threads (see SimulationCommunicatorAsync)
+            std::mutex peerMutex;
+
+            std::vector<char> requestBuffer;
+
+            // Last report published, pushed again to newly connected peers
+            std::string lastReport;
+            std::vector<char> reportBuffer = std::vector<char>(SOCKET_MAX_MESSAGE_SIZE);
+            uint64_t reportSequence = 0;
+            uint64_t reportAcknowledgements = 0;
+            // Whether the last report could not be pushed (the socket was full), so it is retried
+            bool reportPending = false;
+
+            void closePeer() {
+                if (peerSocket >= 0) {
+                    close(peerSocket);
+                    peerSocket = -1;
+                }
+            }
+
+            /*
+             * Accepts a pending connection, if any. A new peer replaces the previous one.
+             */
+            void acceptPeer() {
+                if (listeningSocket < 0)
+                    return;
+
+                int newPeer = accept4(listeningSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (newPeer < 0)
+                    return;
+
+                closePeer();
+                peerSocket = newPeer;
+                watchSocket(peerSocket);
+
+                if (reportSequence > 0)
+                    reportPending = !pushReport(lastReport);
+            }
+
+            void watchSocket(int socketToWatch) {
+                if (requestEvents < 0 || socketToWatch < 0)
+                    return;
+
+                struct epoll_event event = {};
+                event.events = EPOLLIN;
+                event.data.fd = socketToWatch;
+                if (epoll_ctl(requestEvents, EPOLL_CTL_ADD, socketToWatch, &event) != 0)
+                    perror("Could not watch simulation socket");
+            }
+
+            /*
+             * Returns false if the report was dropped because the socket was full (it must be pushed again).
+             */
+            bool pushReport(const std::string & serialized) {
+                if (peerSocket < 0)
+                    return true;
+
+                ssize_t sent = send(peerSocket, serialized.data(), serialized.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+                if (sent >= 0)
+                    return true;
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    return false;
+                // The peer is gone: a new one gets the last report when it connects
+                closePeer();
+                return true;
+            }
+
+        public:
+
+            SimulationCommunicatorSocket(std::string socketPath): socketPath(socketPath), requestBuffer(SOCKET_MAX_MESSAGE_SIZE) {
+                struct sockaddr_un address;
+                if (!fillUnixSocketAddress(socketPath, address)) {
+                    std::cerr << "Socket path too long: " << socketPath << std::endl;
+                    return;
+                }
+
+                listeningSocket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                if (listeningSocket < 0) {
+                    perror("Could not create simulation socket");
+                    return;
+                }
+
+                unlink(socketPath.c_str());
+                if (bind(listeningSocket, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listeningSocket, 1) != 0) {
+                    perror("Could not listen in simulation socket");
+                    close(listeningSocket);
+                    listeningSocket = -1;
+                }
+            }
+
+            ~SimulationCommunicatorSocket() {
+                closePeer();
+                if (requestEvents >= 0)
+                    close(requestEvents);
+                if (listeningSocket >= 0) {
+                    close(listeningSocket);
+                    unlink(socketPath.c_str());
+                }
+            }
+
+            /*
+             * Receive data from the user interface (web browser).
+             *
+             * In this implementation, each request is a packet sent by the peer. Packets
+             * are read in order without blocking.
+             *
+             * It returns true if something was ready into the structure. Requests that cannot
+             * be deserialized are skipped.
+             */
+            bool readRequest(InputDataType & request) {
+                std::lock_guard<std::mutex> lock(peerMutex);
+                acceptPeer();
+
+                while (peerSocket >= 0) {
+                    ssize_t received = recv(peerSocket, requestBuffer.data(), requestBuffer.size(), MSG_DONTWAIT | MSG_TRUNC);
+                    if (received < 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK)
+                            closePeer();
+                        return false;
+                    }
+
+                    if (received == 0) {
+                        // The peer disconnected
+                        closePeer();
+                        return false;
+                    }
+
+                    if (received > 0 && requestBuffer[0] == SOCKET_ACKNOWLEDGEMENT_MARK) {
+                        reportAcknowledgements++;
+                        continue;
+                    }
+
+                    if ((size_t)received > requestBuffer.size()) {
+                        std::cerr << "Discarding request of " << received << " bytes (too long)" << std::endl;
+                        continue;
+                    }
+
+                    if (request.deserialize(std::string(requestBuffer.data(), received)))
+                        return true;
+                }
+                return false;
+            }
+
+            /**
+             * Update latest data so the user interface (web browser) receives it.
+             *
+             * In this implementation, the report is pushed to the peer straight away, unless
+             * it is identical to the last report sent (and that one was not dropped because the
+             * socket was full).
+             */
+            void sendReport(OutputDataType & report) {
+                std::lock_guard<std::mutex> lock(peerMutex);
+                acceptPeer();
+
+                size_t length;
+                {
+                    LL_PROFILE_SCOPE(this->profiler, Serialization);
+                    length = report.serializeTo(reportBuffer.data(), reportBuffer.size());
+                }
+                if (length > reportBuffer.size()) {
+                    std::cerr << "Report of " << length << " bytes does not fit in a socket message" << std::endl;
+                    return;
+                }
+                std::string_view serialized(reportBuffer.data(), length);
+                if (reportSequence > 0 && serialized == lastReport) {
+                    if (reportPending)
+                        reportPending = !pushReport(lastReport);
+                    return;
+                }
+
+                lastReport.assign(serialized.data(), serialized.size());
+                reportSequence++;
+                reportPending = !pushReport(lastReport);
+            }
+
+            /**
+             * Sequence number of the last report published (0 if none was published yet).
+             */
+            uint64_t getReportSequence() const override {
+                return reportSequence;
+            }
+
+            /**
+             * Read acknowledgements: the peer sends a packet starting with a '\0' byte each
+             * time the web server reads a report. Acknowledgements waiting before any request
+             * are consumed here; the rest are consumed by readRequest().
+             */
+            uint64_t getReportAcknowledgements() override {
+                std::lock_guard<std::mutex> lock(peerMutex);
+                acceptPeer();
+
+                char mark;
+                while (peerSocket >= 0 && recv(peerSocket, &mark, 1, MSG_DONTWAIT | MSG_PEEK) == 1 && mark == SOCKET_ACKNOWLEDGEMENT_MARK) {
+                    recv(peerSocket, &mark, 1, MSG_DONTWAIT);
+                    reportAcknowledgements++;
+                }
+                return reportAcknowledgements;
+            }
+
+            bool supportsReportAcknowledgements() const override {
+                return true;
+            }
+
+            /**
+             * Readable when a peer connects or sends packets (requests or acknowledgements).
+             * The descriptor stays readable until the packets are read with readRequest().
+             */
+            int getRequestEventFd() override {
+                std::lock_guard<std::mutex> lock(peerMutex);
+                if (requestEvents < 0) {
+                    requestEvents = epoll_create1(EPOLL_CLOEXEC);
+                    if (requestEvents < 0) {
+                        perror("Could not create simulation socket event poll");
+                        return -1;
+                    }
+                    watchSocket(listeningSocket);
+                    watchSocket(peerSocket);
+                }
+                return requestEvents;
+            }
+
+            bool consumeRequestEvents() override {
+                std::lock_guard<std::mutex> lock(peerMutex);
+                acceptPeer();
+                if (peerSocket < 0)
+                    return false;
+
+                struct pollfd pollDescriptor = { peerSocket, POLLIN, 0 };
+                return poll(&pollDescriptor, 1, 0) > 0;
+            }
+    };
+
+    /*
+     * Minimal peer of SimulationCommunicatorSocket, standing in for the web server (e.g., in
+     * benchmarks or to drive a simulation from another program).
+     */
+    class SimulationCommunicatorSocketPeer {
+        private:
+            int peerSocket = -1;
+
+        public:
+            SimulationCommunicatorSocketPeer() = default;
+
+            ~SimulationCommunicatorSocketPeer() {
+                disconnect();
+            }
+
+            bool connectTo(const std::string & socketPath) {
+                struct sockaddr_un address;
+                if (!fillUnixSocketAddress(socketPath, address))
+                    return false;
+
+                disconnect();
+                peerSocket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+                if (peerSocket < 0)
+                    return false;
+
+                if (connect(peerSocket, (struct sockaddr *)&address, sizeof(address)) != 0) {
+                    disconnect();
+                    return false;
+                }
+                return true;
+            }
+
+            void disconnect() {
+                if (peerSocket >= 0) {
+                    close(peerSocket);
+                    peerSocket = -1;
+                }
+            }
+
+            bool sendRequest(const std::string & request) {
+                if (peerSocket < 0)
+                    return false;
+                return send(peerSocket, request.data(), request.size(), MSG_NOSIGNAL) == (ssize_t)request.size();
+            }
+
+            /*
+             * Tells the simulation that a report was read (see getReportAcknowledgements()).
+             */
+            bool acknowledgeReport() {
+                if (peerSocket < 0)
+                    return false;
+                return send(peerSocket, &SOCKET_ACKNOWLEDGEMENT_MARK, 1, MSG_NOSIGNAL) == 1;
+            }
+
+            /*
+             * Waits up to timeoutMs (-1: forever) for the next report. Returns false on timeout or error.
+             */
+            bool receiveReport(std::string & report, int timeoutMs = -1) {
+                if (peerSocket < 0)
+                    return false;
+
+                struct pollfd pollDescriptor = { peerSocket, POLLIN, 0 };
+                if (poll(&pollDescriptor, 1, timeoutMs) <= 0)
+                    return false;
+
+                report.resize(SOCKET_MAX_MESSAGE_SIZE);
+                ssize_t received = recv(peerSocket, &report[0], report.size(), 0);
+                if (received <= 0) {
+                    report.clear();
+                    return false;
+                }
+                report.resize(received);
+                return true;
+            }
+    };
+
+}
+
+#endif
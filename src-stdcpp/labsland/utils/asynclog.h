@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LL_ASYNC_LOG
+#define LL_ASYNC_LOG
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+namespace LabsLand::Utils {
+
+    /**
+     * Lock-free ring of log bytes, with a single producer (the thread that updates the simulation)
+     * and a single consumer (the AsyncLogWriter thread). The producer never blocks: a message that
+     * does not fit is dropped and counted.
+     */
+    class LogRing {
+        private:
+            std::vector<char> buffer;
+            const size_t mask;
+            // Written by the producer
+            std::atomic<size_t> head = { 0 };
+            // Written by the consumer
+            std::atomic<size_t> tail = { 0 };
+            std::atomic<uint64_t> droppedBytes = { 0 };
+
+            static size_t roundUpToPowerOfTwo(size_t size) {
+                size_t capacity = 1;
+                while (capacity < size)
+                    capacity <<= 1;
+                return capacity;
+            }
+
+        public:
+            LogRing(size_t capacity = 256 * 1024): buffer(roundUpToPowerOfTwo(capacity)), mask(buffer.size() - 1) {}
+
+            /*
+             * Appends the message whole, or drops it if there is not enough room. Producer only.
+             */
+            bool push(const char * data, size_t length) {
+                size_t currentHead = head.load(std::memory_order_relaxed);
+                size_t currentTail = tail.load(std::memory_order_acquire);
+                if (buffer.size() - (currentHead - currentTail) < length) {
+                    droppedBytes.fetch_add(length, std::memory_order_relaxed);
+                    return false;
+                }
+
+                size_t offset = currentHead & mask;
+                size_t first = std::min(length, buffer.size() - offset);
+                memcpy(buffer.data() + offset, data, first);
+                memcpy(buffer.data(), data + first, length - first);
+                head.store(currentHead + length, std::memory_order_release);
+                return true;
+            }
+
+            /*
+             * Writes everything pushed so far to output. Consumer only.
+             */
+            void drainTo(std::ostream & output) {
+                size_t currentTail = tail.load(std::memory_order_relaxed);
+                size_t currentHead = head.load(std::memory_order_acquire);
+                if (currentHead == currentTail)
+                    return;
+
+                size_t length = currentHead - currentTail;
+                size_t offset = currentTail & mask;
+                size_t first = std::min(length, buffer.size() - offset);
+                output.write(buffer.data() + offset, first);
+                output.write(buffer.data(), length - first);
+                tail.store(currentHead, std::memory_order_release);
+            }
+
+            uint64_t takeDroppedBytes() {
+                return droppedBytes.exchange(0, std::memory_order_relaxed);
+            }
+    };
+
+    /**
+     * The thread that writes the log rings to their destinations (the standard output or a file),
+     * every few milliseconds, so the simulations never wait for the writes. There is one per process.
+     */
+    class AsyncLogWriter {
+        private:
+            struct Sink {
+                LogRing * ring;
+                std::ostream * destination;
+            };
+
+            std::mutex mutex;
+            std::condition_variable wakeup;
+            std::vector<Sink> sinks;
+            bool running = true;
+            std::thread thread;
+
+            // Must be called with the mutex locked
+            void drain(Sink & sink) {
+                sink.ring->drainTo(*sink.destination);
+                uint64_t dropped = sink.ring->takeDroppedBytes();
+                if (dropped > 0)
+                    *sink.destination << "[" << dropped << " bytes of log dropped: the log ring was full]\n";
+                sink.destination->flush();
+            }
+
+            void run() {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (running) {
+                    wakeup.wait_for(lock, std::chrono::milliseconds(20));
+                    for (Sink & sink : sinks)
+                        drain(sink);
+                }
+            }
+
+            AsyncLogWriter() {
+                thread = std::thread(&AsyncLogWriter::run, this);
+            }
+
+        public:
+            ~AsyncLogWriter() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    running = false;
+                    for (Sink & sink : sinks)
+                        drain(sink);
+                }
+                wakeup.notify_all();
+                thread.join();
+            }
+
+            static AsyncLogWriter & get() {
+                static AsyncLogWriter writer;
+                return writer;
+            }
+
+            /*
+             * Writes the ring to destination from now on (the previous destination gets what was pushed until now).
+             */
+            void setDestination(LogRing * ring, std::ostream * destination) {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (Sink & sink : sinks) {
+                    if (sink.ring == ring) {
+                        drain(sink);
+                        sink.destination = destination;
+                        return;
+                    }
+                }
+                sinks.push_back({ ring, destination });
+            }
+
+            /*
+             * Writes what is left in the ring and stops writing it (e.g., before destroying it).
+             */
+            void remove(LogRing * ring) {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto sink = sinks.begin(); sink != sinks.end(); ++sink) {
+                    if (sink->ring == ring) {
+                        drain(*sink);
+                        sinks.erase(sink);
+                        return;
+                    }
+                }
+            }
+    };
+
+    /**
+     * Stream buffer that collects what is written to an ostream and pushes it to a LogRing on every
+     * flush (e.g., std::endl), so a message costs a copy instead of a write to the terminal or file.
+     */
+    class LogRingStreamBuf : public std::streambuf {
+        private:
+            LogRing & ring;
+            char pending[1024];
+
+        protected:
+            int_type overflow(int_type character) override {
+                sync();
+                if (character != traits_type::eof()) {
+                    *pptr() = (char)character;
+                    pbump(1);
+                }
+                return traits_type::not_eof(character);
+            }
+
+            int sync() override {
+                if (pptr() > pbase())
+                    ring.push(pbase(), pptr() - pbase());
+                setp(pending, pending + sizeof(pending));
+                return 0;
+            }
+
+        public:
+            LogRingStreamBuf(LogRing & ring): ring(ring) {
+                setp(pending, pending + sizeof(pending));
+            }
+    };
+
+    /**
+     * An ostream over a LogRing written by the AsyncLogWriter (to the standard output, by default).
+     */
+    class AsyncLog {
+        private:
+            LogRing ring;
+            LogRingStreamBuf streamBuffer;
+            std::ostream stream;
+            // The file of setDestination(), if any
+            std::unique_ptr<std::ostream> destination;
+
+        public:
+            AsyncLog(std::ostream & destination): streamBuffer(ring), stream(&streamBuffer) {
+                AsyncLogWriter::get().setDestination(&ring, &destination);
+            }
+
+            ~AsyncLog() {
+                stream.flush();
+                AsyncLogWriter::get().remove(&ring);
+            }
+
+            AsyncLog(const AsyncLog &) = delete;
+            AsyncLog & operator=(const AsyncLog &) = delete;
+
+            std::ostream & getStream() {
+                return stream;
+            }
+
+            /*
+             * Writes the log to a stream owned by this log (e.g., a file) from now on.
+             */
+            void setDestination(std::unique_ptr<std::ostream> newDestination) {
+                stream.flush();
+                AsyncLogWriter::get().setDestination(&ring, newDestination.get());
+                destination = std::move(newDestination);
+            }
+    };
+
+}
+
+#endif
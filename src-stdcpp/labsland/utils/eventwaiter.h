@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LL_EVENT_WAITER
+#define LL_EVENT_WAITER
+
+#include <cstdint>
+#include <vector>
+
+#include <poll.h>
+#include <time.h>
+
+namespace LabsLand::Utils {
+
+    /**
+     * Blocks until one of a set of file descriptors is readable (e.g., the watch of the
+     * input files of a target device or the socket of a communicator) or a timeout expires.
+     */
+    class EventWaiter {
+        private:
+            std::vector<struct pollfd> descriptors;
+
+        public:
+            /*
+             * Adds a descriptor to wait for. Negative descriptors (not available) are ignored.
+             */
+            void add(int fd) {
+                if (fd >= 0)
+                    descriptors.push_back({ fd, POLLIN, 0 });
+            }
+
+            bool empty() const {
+                return descriptors.empty();
+            }
+
+            /*
+             * Waits for up to timeoutUs microseconds (forever if it is negative). Returns
+             * whether any descriptor is readable.
+             */
+            bool wait(int64_t timeoutUs) {
+                struct timespec timeout;
+                timeout.tv_sec = timeoutUs / 1000000;
+                timeout.tv_nsec = (timeoutUs % 1000000) * 1000;
+
+                int ready = ppoll(descriptors.data(), descriptors.size(), timeoutUs < 0 ? nullptr : &timeout, nullptr);
+                return ready > 0;
+            }
+    };
+
+}
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LL_FILE_WATCHER
+#define LL_FILE_WATCHER
+
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include <unistd.h>
+#include <sys/inotify.h>
+
+namespace LabsLand::Utils {
+
+    /**
+     * Watches a set of files with inotify, so a loop can block on getFd() until one of
+     * them is written instead of reading them periodically.
+     *
+     * The directories of the files are watched (not the files themselves), so files that
+     * do not exist yet or that are replaced with a rename are also seen. Only complete
+     * writes count: a file closed after writing it, or renamed over the watched name.
+     */
+    class FileWatcher {
+        private:
+            struct Watch {
+                int descriptor;
+                std::string name;
+            };
+
+            int fd = -1;
+            std::vector<Watch> watches;
+
+        public:
+            FileWatcher() {
+                fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+                if (fd < 0)
+                    perror("Could not create file watcher");
+            }
+
+            ~FileWatcher() {
+                if (fd >= 0)
+                    close(fd);
+            }
+
+            FileWatcher(const FileWatcher &) = delete;
+            FileWatcher & operator=(const FileWatcher &) = delete;
+
+            bool addFile(const std::string & path) {
+                if (fd < 0)
+                    return false;
+
+                size_t slash = path.rfind('/');
+                std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+                std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+                int descriptor = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+                if (descriptor < 0) {
+                    perror(("Could not watch " + path).c_str());
+                    return false;
+                }
+                watches.push_back({ descriptor, name });
+                return true;
+            }
+
+            /*
+             * Readable when there are events to consume (which might be of other files of the same directories).
+             */
+            int getFd() const {
+                return fd;
+            }
+
+            /*
+             * Consumes the pending events. Returns whether any of the watched files was written.
+             */
+            bool consumeEvents() {
+                if (fd < 0)
+                    return true;
+
+                alignas(struct inotify_event) char buffer[4096];
+                bool written = false;
+                while (true) {
+                    ssize_t length = read(fd, buffer, sizeof(buffer));
+                    if (length <= 0)
+                        return written;
+
+                    for (char * position = buffer; position < buffer + length; ) {
+                        struct inotify_event * event = (struct inotify_event *)position;
+                        if (event->len > 0) {
+                            for (const Watch & watch : watches) {
+                                if (watch.descriptor == event->wd && watch.name == event->name)
+                                    written = true;
+                            }
+                        }
+                        position += sizeof(struct inotify_event) + event->len;
+                    }
+                }
+            }
+    };
+
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LL_JITTER_HISTOGRAM
+#define LL_JITTER_HISTOGRAM
+
+#include <cstdint>
+#include <ostream>
+
+namespace LabsLand::Utils {
+
+    /**
+     * Histogram of how late the ticks of a loop start compared with their scheduled time, with
+     * power of two buckets (0 us, 1 us, 2-3 us, 4-7 us... up to 2^31 us), so recording is cheap
+     * and it does not allocate.
+     */
+    class JitterHistogram {
+        public:
+            static const int BUCKETS = 33;
+
+        private:
+            uint64_t counts[BUCKETS] = {};
+            uint64_t samples = 0;
+            uint64_t totalUs = 0;
+            uint64_t maxUs = 0;
+
+            static int bucketOf(uint64_t latenessUs) {
+                int bucket = 0;
+                while (latenessUs > 0 && bucket < BUCKETS - 1) {
+                    latenessUs >>= 1;
+                    bucket++;
+                }
+                return bucket;
+            }
+
+            // Upper bound (exclusive) of a bucket, in microseconds
+            static uint64_t bucketLimit(int bucket) {
+                return (uint64_t)1 << bucket;
+            }
+
+        public:
+            void record(uint64_t latenessUs) {
+                counts[bucketOf(latenessUs)]++;
+                samples++;
+                totalUs += latenessUs;
+                if (latenessUs > maxUs)
+                    maxUs = latenessUs;
+            }
+
+            uint64_t getSamples() const {
+                return samples;
+            }
+
+            /*
+             * Upper bound of the lateness of the given fraction of the ticks (e.g., 0.99).
+             */
+            uint64_t getPercentileUs(double fraction) const {
+                uint64_t target = (uint64_t)(fraction * samples + 0.5);
+                uint64_t accumulated = 0;
+                for (int bucket = 0; bucket < BUCKETS; bucket++) {
+                    accumulated += counts[bucket];
+                    if (accumulated >= target && accumulated > 0)
+                        return bucketLimit(bucket) - 1 < maxUs ? bucketLimit(bucket) - 1 : maxUs;
+                }
+                return maxUs;
+            }
+
+            void print(std::ostream & output) const {
+                output << "Tick jitter (actual - scheduled start): " << samples << " ticks";
+                if (samples == 0) {
+                    output << std::endl;
+                    return;
+                }
+                output << ", mean " << (double)totalUs / samples << " us, p50 <= " << getPercentileUs(0.5)
+                       << " us, p99 <= " << getPercentileUs(0.99) << " us, p99.9 <= " << getPercentileUs(0.999)
+                       << " us, max " << maxUs << " us" << std::endl;
+
+                uint64_t accumulated = 0;
+                for (int bucket = 0; bucket < BUCKETS; bucket++) {
+                    if (counts[bucket] == 0)
+                        continue;
+                    accumulated += counts[bucket];
+                    output << "  " << (bucket == 0 ? 0 : bucketLimit(bucket - 1)) << "-" << bucketLimit(bucket) - 1 << " us: "
+                           << counts[bucket] << " (" << 100.0 * counts[bucket] / samples << "%, cumulative "
+                           << 100.0 * accumulated / samples << "%)" << std::endl;
+                }
+            }
+
+            void reset() {
+                *this = JitterHistogram();
+            }
+    };
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LL_REALTIME
+#define LL_REALTIME
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <alloca.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+namespace LabsLand::Utils {
+
+    /**
+     * Settings that reduce the jitter the Linux scheduler adds to the ticks of a simulation on a
+     * shared host. They apply to the calling thread and are inherited by the threads it creates
+     * afterwards. They are all best effort: if they are not permitted (e.g., SCHED_FIFO without
+     * CAP_SYS_NICE), a warning is printed and the simulation runs without them.
+     */
+    namespace Realtime {
+
+        /*
+         * Runs the thread only on the given CPU, so it keeps its caches and is not migrated.
+         */
+        inline bool pinToCpu(int cpu) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu, &cpus);
+            if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+                perror(("Could not pin the simulation to CPU " + std::to_string(cpu)).c_str());
+                return false;
+            }
+            return true;
+        }
+
+        /*
+         * Real-time FIFO scheduling with the given priority (1-99): the thread preempts every normal
+         * process as soon as it wakes up.
+         */
+        inline bool setFifoPriority(int priority) {
+            struct sched_param param;
+            memset(&param, 0, sizeof(param));
+            param.sched_priority = priority;
+            if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+                perror("Could not use SCHED_FIFO (it requires CAP_SYS_NICE or an RLIMIT_RTPRIO)");
+                return false;
+            }
+            return true;
+        }
+
+        /*
+         * Nice level (-20 to 19, lower is a higher priority) for the normal scheduler.
+         */
+        inline bool setNiceLevel(int nice) {
+            if (setpriority(PRIO_PROCESS, 0, nice) != 0) {
+                perror(("Could not set the nice level to " + std::to_string(nice)).c_str());
+                return false;
+            }
+            return true;
+        }
+
+        /*
+         * Touches stackBytes of the stack, so the page faults happen now and not in the first ticks
+         * that go that deep.
+         */
+        __attribute__((noinline)) inline void prefaultStack(size_t stackBytes = 256 * 1024) {
+            volatile unsigned char * stack = (volatile unsigned char *)alloca(stackBytes);
+            for (size_t i = 0; i < stackBytes; i += 4096)
+                stack[i] = 0;
+        }
+
+        /*
+         * Locks the current and future memory of the process in RAM (so it is never paged out) and
+         * pre-faults the stack.
+         */
+        inline bool lockMemory() {
+            if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+                perror("Could not lock the memory (it requires CAP_IPC_LOCK or a large RLIMIT_MEMLOCK)");
+                return false;
+            }
+            prefaultStack();
+            return true;
+        }
+    }
+
+}
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LL_TICK_SCHEDULER
+#define LL_TICK_SCHEDULER
+
+#include <cstdint>
+#include <ostream>
+
+#include "timemanagerstd.h"
+#include "eventwaiter.h"
+#include "jitterhistogram.h"
+
+namespace LabsLand::Utils {
+
+    /**
+     * Periodic wakeups for the update loop of a simulation. Each tick has an absolute
+     * deadline (start + n * period), so the time spent in the updates or sleeping too
+     * long does not accumulate as drift.
+     *
+     * If an update takes longer than the period (an overrun), the missed deadlines are
+     * skipped instead of running a burst of updates to catch up.
+     */
+    class TickScheduler {
+        private:
+            const TimeManagerStd & timeManager;
+            const uint64_t periodUs;
+            clock_t nextDeadline;
+
+            clock_t statsStart;
+            uint64_t ticks = 0;
+            uint64_t overruns = 0;
+            uint64_t skippedTicks = 0;
+            uint64_t maxLatenessUs = 0;
+            // Lateness of every wakeup since the scheduler was created (not reset with the stats)
+            JitterHistogram jitter;
+            // Whether waitNextTick(events) was interrupted and the tick is still being waited for
+            bool waitingTick = false;
+
+            /*
+             * Accounts a new tick, skipping the deadlines already missed by the update.
+             */
+            void beginTick() {
+                ticks++;
+                clock_t now = timeManager.getAbsoluteTime();
+                if (now >= nextDeadline) {
+                    // The update did not finish in time
+                    overruns++;
+                    uint64_t missed = (now - nextDeadline) / periodUs + 1;
+                    skippedTicks += missed - 1;
+                    nextDeadline += missed * periodUs;
+                }
+            }
+
+            void finishTick() {
+                timeManager.sleepUntil(nextDeadline);
+
+                uint64_t latenessUs = timeManager.getAbsoluteTime() - nextDeadline;
+                if (latenessUs > maxLatenessUs)
+                    maxLatenessUs = latenessUs;
+                jitter.record(latenessUs);
+                nextDeadline += periodUs;
+            }
+
+        public:
+            TickScheduler(const TimeManagerStd & timeManager, uint64_t periodUs):
+                timeManager(timeManager), periodUs(periodUs > 0 ? periodUs : 1) {
+                nextDeadline = timeManager.getAbsoluteTime() + this->periodUs;
+                statsStart = timeManager.getAbsoluteTime();
+            }
+
+            /**
+             * Waits until the deadline of the next tick.
+             */
+            void waitNextTick() {
+                if (!waitingTick)
+                    beginTick();
+                waitingTick = false;
+                finishTick();
+            }
+
+            /**
+             * Waits until the deadline of the next tick, or until one of the descriptors of events is
+             * readable. Returns true if it was interrupted by an event, in which case the next call keeps
+             * waiting for the same deadline (the tick is not over yet).
+             */
+            bool waitNextTick(EventWaiter & events) {
+                if (!waitingTick)
+                    beginTick();
+
+                // The kernel only waits until the time left to spin (see TimeManagerStd::sleepUntil())
+                clock_t now = timeManager.getAbsoluteTime();
+                clock_t wakeup = nextDeadline - timeManager.getSpinThresholdUs();
+                if (!events.empty() && now < wakeup && events.wait(wakeup - now)) {
+                    waitingTick = true;
+                    return true;
+                }
+
+                waitingTick = false;
+                finishTick();
+                return false;
+            }
+
+            uint64_t getPeriodUs() const {
+                return periodUs;
+            }
+
+            uint64_t getTicks() const {
+                return ticks;
+            }
+
+            uint64_t getOverruns() const {
+                return overruns;
+            }
+
+            /**
+             * Ticks per second since the scheduler was created (or the stats were reset).
+             */
+            double getAchievedRate() const {
+                clock_t elapsed = timeManager.getAbsoluteTime() - statsStart;
+                return elapsed > 0 ? ticks * 1e6 / elapsed : 0;
+            }
+
+            const JitterHistogram & getJitterHistogram() const {
+                return jitter;
+            }
+
+            void printStats(std::ostream & output) const {
+                output << "Ticks: " << ticks << " at " << getAchievedRate() << " Hz (target " << 1e6 / periodUs << " Hz); "
+                       << overruns << " overruns (" << skippedTicks << " ticks skipped); "
+                       << "max wakeup lateness " << maxLatenessUs << " us" << std::endl;
+            }
+
+            void resetStats() {
+                statsStart = timeManager.getAbsoluteTime();
+                ticks = 0;
+                overruns = 0;
+                skippedTicks = 0;
+                maxLatenessUs = 0;
+            }
+    };
+
+}
+
+#endif
@@ -5,29 +5,84 @@
  * This software is licensed as described in the file LICENSE, which
  * you should have received as part of this distribution.
  */
-#include <thread>
-#include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <time.h>
 
 #include "timemanagerstd.h"
 
 using namespace LabsLand::Utils;
 
+namespace {
+
+    // Bounds of the calibrated spin threshold, in microseconds. Every sleep spins for up to the threshold, so
+    // on a loaded host (where the kernel wakes up late) it is capped rather than burning the CPU it is short of
+    const uint32_t MIN_SPIN_THRESHOLD_US = 20;
+    const uint32_t MAX_SPIN_THRESHOLD_US = 100;
+
+    uint64_t monotonicNowNs() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+    }
+
+    void kernelSleepUntilNs(uint64_t deadlineNs) {
+        struct timespec deadline;
+        deadline.tv_sec = deadlineNs / 1000000000ull;
+        deadline.tv_nsec = deadlineNs % 1000000000ull;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {}
+    }
+
+    /*
+     * How late the kernel wakes us up: the 90th percentile of the delay of a few short
+     * sleeps, with some margin.
+     */
+    uint32_t calibrateSpinThresholdUs() {
+        const int samples = 20;
+        uint64_t delaysNs[samples];
+        for (int i = 0; i < samples; i++) {
+            uint64_t deadline = monotonicNowNs() + 50000;
+            kernelSleepUntilNs(deadline);
+            delaysNs[i] = monotonicNowNs() - deadline;
+        }
+        std::sort(delaysNs, delaysNs + samples);
+        uint64_t thresholdUs = delaysNs[samples * 9 / 10] * 3 / 2 / 1000;
+        return (uint32_t)std::min<uint64_t>(std::max<uint64_t>(thresholdUs, MIN_SPIN_THRESHOLD_US), MAX_SPIN_THRESHOLD_US);
+    }
+}
+
+TimeManagerStd::TimeManagerStd(): spinThresholdUs(calibrateSpinThresholdUs()) {
+}
+
 void TimeManagerStd::sleepMs(uint32_t ms) const {
-    std::this_thread::sleep_for (std::chrono::milliseconds(ms));
+    sleepUntil(getAbsoluteTime() + (LabsLand::Utils::clock_t)ms * 1000);
 }
 
 void TimeManagerStd::sleepUs(uint32_t us) const {
-    std::this_thread::sleep_for (std::chrono::microseconds(us));
+    sleepUntil(getAbsoluteTime() + us);
+}
+
+void TimeManagerStd::sleepUntil(LabsLand::Utils::clock_t deadline) const {
+    uint64_t deadlineNs = deadline * 1000;
+    uint64_t spinThresholdNs = (uint64_t)spinThresholdUs * 1000;
+    if (deadlineNs > monotonicNowNs() + spinThresholdNs)
+        kernelSleepUntilNs(deadlineNs - spinThresholdNs);
+
+    while (monotonicNowNs() < deadlineNs) {}
 }
 
 LabsLand::Utils::clock_t TimeManagerStd::getAbsoluteTime() const {
-    auto now = std::chrono::system_clock::now();
-    auto duration = now.time_since_epoch();
-    return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    return monotonicNowNs() / 1000;
 }
 
 uint64_t TimeManagerStd::getClocksPerSec() const {
-    // Should be CLOCKS_PER_SEC
-    return 1000;
+    return 1000000;
 }
 
+void TimeManagerStd::setSpinThresholdUs(uint32_t spinThresholdUs) {
+    this->spinThresholdUs = spinThresholdUs;
+}
+
+uint32_t TimeManagerStd::getSpinThresholdUs() const {
+    return spinThresholdUs;
+}
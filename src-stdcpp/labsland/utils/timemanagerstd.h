@@ -12,18 +12,39 @@
 
 namespace LabsLand::Utils {
 
+    /**
+     * Time from the monotonic clock (CLOCK_MONOTONIC, the one of std::chrono::steady_clock),
+     * in microseconds. It does not jump with NTP or manual changes of the system time.
+     *
+     * Sleeps are hybrid: the kernel is asked to sleep until shortly before the deadline,
+     * and the remaining time is spent spinning on the clock. How much time is left for
+     * spinning is calibrated when the TimeManagerStd is created, from how late the kernel
+     * wakes up in this machine (between 20 and 100 us), unless it is set explicitly.
+     */
     class TimeManagerStd : public TimeManager {
+        private:
+            uint32_t spinThresholdUs;
+
         public:
+            TimeManagerStd();
+
             // sleep a number of milliseconds
             virtual void sleepMs(uint32_t ms) const override;
 
             // sleep a number of microseconds
             virtual void sleepUs(uint32_t us) const override;
 
+            // sleep until getAbsoluteTime() reaches deadline
+            void sleepUntil(clock_t deadline) const;
+
             // get time since boot in microseconds
             virtual clock_t getAbsoluteTime() const override;
 
             virtual uint64_t getClocksPerSec() const override;
+
+            // the last part of each sleep (in microseconds) that is spent spinning (0: only the kernel sleeps)
+            void setSpinThresholdUs(uint32_t spinThresholdUs);
+            uint32_t getSpinThresholdUs() const;
     };
 
 }
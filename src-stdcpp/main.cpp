@@ -6,8 +6,18 @@
  * you should have received as part of this distribution.
  */
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <ctime>
 #include <thread>
 #include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+#include <cerrno>
+#include <csignal>
+#include <sys/stat.h>
 #include "labsland/simulations/watertanksimulation.h"
 #include "rhlab/butterfly.h"
 #include "rhlab/matrix.h"
@@ -15,65 +25,325 @@
 #include "deusto/door.h"
 #include "deusto/watertankDeusto.h"
 #include "labsland/simulations/utils/communicatorfiles.h"
+#include "labsland/simulations/utils/communicatorsocket.h"
+#include "labsland/simulations/utils/communicatorsharedmemory.h"
+#include "labsland/simulations/utils/communicatorasync.h"
 #include "labsland/simulations/targetdevicefiles.h"
 #include "labsland/utils/timemanagerstd.h"
+#include "labsland/utils/timemanagervirtual.h"
+#include "labsland/utils/tickscheduler.h"
+#include "labsland/utils/eventwaiter.h"
+#include "labsland/utils/realtime.h"
+#include "benchmarks.h"
+#include "simulationhost.h"
 
 using namespace std;
 using namespace LabsLand::Simulations::Utils;
 
-class SimulationRunner {
+// Set by the signal handlers (installed by main() for every mode), checked by the loops of the modes
+volatile sig_atomic_t jitterReportRequested = 0;
+volatile sig_atomic_t stopRequested = 0;
+
+void onJitterReportSignal(int) {
+    jitterReportRequested = 1;
+}
+
+void onStopSignal(int) {
+    stopRequested = 1;
+}
+
+/*
+ * Writes a jitter histogram to --jitter-file=<path> (replacing it) or to the standard output.
+ */
+void writeJitterReport(const LabsLand::Utils::JitterHistogram & jitter, map<string, string> & options) {
+    if (options.count("jitter-file") == 0) {
+        jitter.print(cout);
+        return;
+    }
+    ofstream output(options["jitter-file"], ios::trunc);
+    if (!output.is_open()) {
+        cerr << "Could not write the jitter report to " << options["jitter-file"] << endl;
+        return;
+    }
+    jitter.print(output);
+}
+
+class SimulationRunner : public HostedSimulation {
     public:
+        /*
+         * Creates the backends and initializes the simulation. The files and the socket are created in directory
+         * (the current one if it is empty, otherwise the log also goes to a file there), and the shared memory
+         * is named sharedMemoryName. If timeManager is null, one is created for the mode.
+         */
+        virtual bool setUp(const string & directory = "", const string & sharedMemoryName = "/hybridapi",
+                           shared_ptr<LabsLand::Utils::TimeManagerStd> timeManager = nullptr) = 0;
+
+        /*
+         * Runs the simulation in the mode requested (blocks). setUp() must have been called.
+         */
         virtual void run() = 0;
 };
 
 template <class SimulationClass, class OutputDataType, class InputDataType>
 class ConcreteSimulationRunner : public SimulationRunner {
     private:
-        string configuration; // "files" or anything else in the future (e.g., maybe provide another class or whatever)
-        string mode; // "run" or "run-fast"
+        string configuration; // "files", "socket" (messages through the hybridapi.sock Unix socket) or "shm" (messages through the /hybridapi shared memory)
+        string mode; // "run", "run-fast" (virtual time, as fast as possible) or "event" (update only when something happens)
+        map<string, string> options; // --key=value arguments (see main())
+
+        shared_ptr<LabsLand::Utils::TimeManager> timeManager = nullptr;
+        shared_ptr<LabsLand::Utils::TimeManagerVirtual> virtualTimeManager = nullptr;
+        shared_ptr<LabsLand::Utils::TimeManagerStd> stdTimeManager = nullptr;
+        shared_ptr<LabsLand::Utils::TargetDevice> targetDevice = nullptr;
+        shared_ptr<SimulationCommunicator<OutputDataType, InputDataType>> communicator = nullptr;
+        shared_ptr<SimulationCommunicatorAsync<OutputDataType, InputDataType>> asyncCommunicator = nullptr;
+        SimulationClass simulation;
+
+        // --profile-file: where the per-phase percentiles are appended every --profile-interval seconds (see updateSimulation())
+        unique_ptr<ofstream> profileFile = nullptr;
+        uint64_t profileIntervalUs = 0;
+        LabsLand::Utils::clock_t nextProfile = 0;
+
     public:
-        ConcreteSimulationRunner(const string & config, const string & mode): configuration(config), mode(mode) {}
+        ConcreteSimulationRunner(const string & config, const string & mode, const map<string, string> & options): configuration(config), mode(mode), options(options) {}
+
+        bool setUp(const string & directory, const string & sharedMemoryName, shared_ptr<LabsLand::Utils::TimeManagerStd> sharedTimeManager) override {
+            if (mode == "run-fast") {
+                virtualTimeManager = make_shared<LabsLand::Utils::TimeManagerVirtual>();
+                timeManager = virtualTimeManager;
+            } else {
+                stdTimeManager = sharedTimeManager != nullptr ? sharedTimeManager : make_shared<LabsLand::Utils::TimeManagerStd>();
+                if (options.count("spin-us") > 0)
+                    stdTimeManager->setSpinThresholdUs(stoul(options["spin-us"]));
+                timeManager = stdTimeManager;
+            }
+
+            auto path = [&directory](const string & filename) {
+                return directory.empty() ? filename : directory + "/" + filename;
+            };
+            shared_ptr<LabsLand::Utils::TargetDeviceFiles> targetDeviceFiles = make_shared<LabsLand::Utils::TargetDeviceFiles>(20, 10,
+                    path("output-gpios.txt"), path("input-gpios.txt"),
+                    path("output-i2c-1.txt"), path("input-i2c-1.txt"), path("signal-i2c-1.txt"),
+                    path("output-i2c-2.txt"), path("input-i2c-2.txt"), path("signal-i2c-2.txt"),
+                    path("output-spi.txt"), path("input-spi.txt"), path("signal-spi.txt"));
+            if (!directory.empty())
+                targetDeviceFiles->setLogFile(path("simulation.log"));
+            if (options.count("log-level") > 0) {
+                LabsLand::Utils::LogLevel logLevel;
+                if (!LabsLand::Utils::parseLogLevel(options["log-level"], logLevel)) {
+                    cerr << "Invalid log level: " << options["log-level"] << " (use trace, debug, info, warning, error or off)" << endl;
+                    return false;
+                }
+                targetDeviceFiles->setLogLevel(logLevel);
+            }
+            targetDevice = targetDeviceFiles;
 
-        void run() {
-            shared_ptr<LabsLand::Utils::TimeManager> timeManager = make_shared<LabsLand::Utils::TimeManagerStd>();
-            shared_ptr<LabsLand::Utils::TargetDevice> targetDevice = nullptr;
-            shared_ptr<SimulationCommunicator<OutputDataType, InputDataType>> communicator = nullptr;
             if (configuration == "files") {
-                targetDevice = make_shared<LabsLand::Utils::TargetDeviceFiles>(20, 10);
-                communicator = make_shared<SimulationCommunicatorFiles<OutputDataType, InputDataType>>("output-messages.txt", "input-messages.txt");
+                communicator = make_shared<SimulationCommunicatorFiles<OutputDataType, InputDataType>>(path("output-messages.txt"), path("input-messages.txt"));
+            } else if (configuration == "socket") {
+                communicator = make_shared<SimulationCommunicatorSocket<OutputDataType, InputDataType>>(path("hybridapi.sock"));
+            } else if (configuration == "shm") {
+                communicator = make_shared<SimulationCommunicatorSharedMemory<OutputDataType, InputDataType>>(sharedMemoryName);
             } else {
                 // Add here other implementations
                 cerr << "Unsupported configuration: " << configuration << endl;
-                return;
+                return false;
             }
-            SimulationClass simulation;
+
+            if (options.count("async-reports") > 0) {
+                asyncCommunicator = make_shared<SimulationCommunicatorAsync<OutputDataType, InputDataType>>(communicator);
+                communicator = asyncCommunicator;
+            }
+
             simulation.injectTimeManager(timeManager);
             simulation.injectCommunicator(communicator);
             simulation.injectTargetDevice(targetDevice);
 
+            if (options.count("profile-file") > 0) {
+#ifdef LL_PROFILING
+                profileFile = make_unique<ofstream>(path(options["profile-file"]), ios::app);
+                if (!profileFile->is_open()) {
+                    cerr << "Could not open the profile file " << path(options["profile-file"]) << endl;
+                    return false;
+                }
+                profileIntervalUs = (options.count("profile-interval") > 0 ? stoull(options["profile-interval"]) : 10) * 1000000;
+                nextProfile = timeManager->getAbsoluteTime() + profileIntervalUs;
+#else
+                cerr << "Profiling is not available: build with -DLL_PROFILING=ON to use --profile-file" << endl;
+#endif
+            }
+
             simulation._initialize();
+            return true;
+        }
+
+        /*
+         * Updates the simulation and, every --profile-interval seconds, appends the profile of the ticks
+         * since the last time to the --profile-file as a line of JSON.
+         */
+        void updateSimulation() {
+            simulation._update();
+#ifdef LL_PROFILING
+            if (profileFile != nullptr && timeManager->getAbsoluteTime() >= nextProfile)
+                writeProfile();
+#endif
+        }
+
+#ifdef LL_PROFILING
+        void writeProfile() {
+            LabsLand::Utils::clock_t now = timeManager->getAbsoluteTime();
+            simulation.getProfiler().writeJsonLine(*profileFile, now);
+            profileFile->flush();
+            simulation.getProfiler().reset();
+            nextProfile = now + profileIntervalUs;
+        }
+#endif
+
+        void tick() override {
+            updateSimulation();
+        }
+
+        /*
+         * The step requested by the simulation (--step-us=<us> overrides it), 100 ms by default.
+         */
+        uint64_t getStepUs() override {
+            uint64_t stepUs = simulation.getSleepStepInUs();
+            if (stepUs == 0)
+                stepUs = (uint64_t)simulation.getSleepStepInMs() * 1000;
+            if (stepUs == 0)
+                stepUs = 100000;
+            if (options.count("step-us") > 0)
+                stepUs = stoull(options["step-us"]);
+            return stepUs;
+        }
+
+        void run() override {
+            if (mode == "event" && !simulation.isEventDriven()) {
+                cerr << "This simulation needs periodic updates: running it in run mode" << endl;
+                mode = "run";
+            }
 
             if (mode == "run-fast") {
-                std::clock_t currentClock = clock();
-                int i = 0;
-                while(i < 100) {
-                    currentClock += 0.1 * CLOCKS_PER_SEC; // Make the simulation advance 100 ms.
-                    simulation._update(currentClock);
-                    i++;
-
-                    cout << "Current state: " << simulation.mState.serialize() << endl;
-                    cout << endl;
+                // --ticks=<number of updates> (100 by default), --step-us=<virtual time between updates> (100 ms by default)
+                uint64_t ticks = options.count("ticks") > 0 ? stoull(options["ticks"]) : 100;
+                uint64_t stepUs = options.count("step-us") > 0 ? stoull(options["step-us"]) : 100000;
+                bool printStates = options.count("print-states") > 0;
+
+                // There is no jitter in virtual time: SIGUSR1 is ignored, and SIGINT or SIGTERM end the run early
+                auto start = chrono::steady_clock::now();
+                for (uint64_t i = 0; i < ticks && !stopRequested; i++) {
+                    virtualTimeManager->advanceUs(stepUs);
+                    updateSimulation();
+
+                    if (printStates)
+                        cout << "Current state: " << simulation.mState.serialize() << endl;
                 }
+                double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+#ifdef LL_PROFILING
+                if (profileFile != nullptr)
+                    writeProfile();
+#endif
+                cout << "Final state: " << simulation.mState.serialize() << endl;
+                cout << ticks << " ticks, " << ticks * stepUs / 1e6 << " s of simulated time in " << elapsed << " s ("
+                     << (elapsed > 0 ? ticks / elapsed : 0) << " ticks/s)" << endl;
+                if (asyncCommunicator != nullptr)
+                    asyncCommunicator->printStats(cout);
             } else if (mode == "run") {
-                time_t end_time;
-                while (true) {
-                    auto end = std::chrono::system_clock::now();
-                    end_time = std::chrono::system_clock::to_time_t(end);
-                    string timeString(ctime(&end_time));
-
-                    cout << "[" << timeString.substr(0, timeString.size() - 1) << "] Running _update()" << endl;
-                    simulation._update();
-                    this_thread::sleep_for (chrono::milliseconds(100));
+                LabsLand::Utils::TickScheduler scheduler(*stdTimeManager, getStepUs());
+                // Print the stats of the scheduler every --stats-interval seconds (10 by default, 0 to disable)
+                uint64_t statsIntervalUs = (options.count("stats-interval") > 0 ? stoull(options["stats-interval"]) : 10) * 1000000;
+                LabsLand::Utils::clock_t nextStats = stdTimeManager->getAbsoluteTime() + statsIntervalUs;
+
+                // Requests interrupt the wait for the next tick, so they are handled straight away: dispatched to
+                // onRequest() if the simulation supports it, or otherwise with an extra update (one per tick)
+                LabsLand::Utils::EventWaiter requestEvents;
+                requestEvents.add(communicator->getRequestEventFd());
+
+                // The jitter histogram is written on SIGUSR1 and at exit (SIGINT or SIGTERM)
+                while (!stopRequested) {
+                    updateSimulation();
+                    while (scheduler.waitNextTick(requestEvents)) {
+                        if (!communicator->consumeRequestEvents())
+                            continue;
+                        if (simulation.dispatchesRequests()) {
+                            simulation._dispatchRequests();
+                        } else {
+                            updateSimulation();
+                            scheduler.waitNextTick();
+                            break;
+                        }
+                    }
+
+                    if (statsIntervalUs > 0 && stdTimeManager->getAbsoluteTime() >= nextStats) {
+                        scheduler.printStats(cout);
+                        scheduler.resetStats();
+                        nextStats += statsIntervalUs;
+                    }
+                    if (jitterReportRequested) {
+                        jitterReportRequested = 0;
+                        writeJitterReport(scheduler.getJitterHistogram(), options);
+                    }
+                }
+                writeJitterReport(scheduler.getJitterHistogram(), options);
+            } else if (mode == "event") {
+                // Block until an input changes, a request arrives, a wakeup scheduled by the simulation expires or
+                // a report is due. Inputs or requests that cannot be waited for are polled every 50 ms instead.
+                LabsLand::Utils::EventWaiter waiter;
+                int inputFd = targetDevice->getInputEventFd();
+                int requestFd = communicator->getRequestEventFd();
+                waiter.add(inputFd);
+                waiter.add(requestFd);
+                int64_t pollingUs = (inputFd < 0 || requestFd < 0) ? 50000 : -1;
+
+                uint64_t statsIntervalUs = (options.count("stats-interval") > 0 ? stoull(options["stats-interval"]) : 10) * 1000000;
+                LabsLand::Utils::clock_t statsStart = stdTimeManager->getAbsoluteTime();
+                std::clock_t statsStartCpu = std::clock();
+                uint64_t wakeups = 0;
+                uint64_t updates = 1;
+
+                // There are no ticks to be late: SIGUSR1 is ignored, and SIGINT or SIGTERM (which interrupt the
+                // wait) end the loop
+                updateSimulation();
+                while (!stopRequested) {
+                    // update() reads one request at a time: go on while there might be more pending
+                    while (simulation.readRequestInLastUpdate()) {
+                        updateSimulation();
+                        updates++;
+                    }
+
+                    LabsLand::Utils::clock_t now = stdTimeManager->getAbsoluteTime();
+                    LabsLand::Utils::clock_t deadline = min(simulation.getNextWakeup(), simulation.getNextReport());
+                    if (statsIntervalUs > 0)
+                        deadline = min(deadline, statsStart + statsIntervalUs);
+                    int64_t timeoutUs = deadline == LabsLand::Utils::TimerWheel::NEVER ? -1 : (deadline > now ? (int64_t)(deadline - now) : 0);
+                    if (pollingUs >= 0 && (timeoutUs < 0 || timeoutUs > pollingUs))
+                        timeoutUs = pollingUs;
+
+                    waiter.wait(timeoutUs);
+                    wakeups++;
+
+                    bool inputsChanged = targetDevice->consumeInputEvents();
+                    bool requestsArrived = communicator->consumeRequestEvents();
+                    now = stdTimeManager->getAbsoluteTime();
+                    if (inputsChanged || requestsArrived || simulation.getNextWakeup() <= now) {
+                        updateSimulation();
+                        updates++;
+                    } else {
+                        // Nothing changed: only send the report that might be due
+                        simulation._updateReport(now);
+                    }
+
+                    if (statsIntervalUs > 0 && now >= statsStart + statsIntervalUs) {
+                        double seconds = (now - statsStart) / 1e6;
+                        double cpuSeconds = (std::clock() - statsStartCpu) / (double)CLOCKS_PER_SEC;
+                        cout << "Event loop: " << wakeups << " wake-ups, " << updates << " updates in " << seconds << " s; "
+                             << "CPU " << 100 * cpuSeconds / seconds << "%" << endl;
+                        statsStart = now;
+                        statsStartCpu = std::clock();
+                        wakeups = 0;
+                        updates = 0;
+                    }
                 }
             } else {
                 cerr << "Unsupported mode: " << mode << endl;
@@ -82,48 +352,179 @@ class ConcreteSimulationRunner : public SimulationRunner {
 };
 
 
+typedef unique_ptr<SimulationRunner> (*RunnerFactory)(const string & configuration, const string & mode, const map<string, string> & options);
+
+template <class SimulationClass, class OutputDataType, class InputDataType>
+unique_ptr<SimulationRunner> createRunner(const string & configuration, const string & mode, const map<string, string> & options) {
+    return make_unique<ConcreteSimulationRunner<SimulationClass, OutputDataType, InputDataType>>(configuration, mode, options);
+}
+
+/*
+ * The simulations that can be run, by name. Add new simulations here.
+ */
+const map<string, RunnerFactory> & getSimulationRunners() {
+    static const map<string, RunnerFactory> runners = {
+        { "matrix", createRunner<RHLab::LEDMatrix::MatrixSimulation, RHLab::LEDMatrix::MatrixData, RHLab::LEDMatrix::MatrixRequest> },
+        { "watertank", createRunner<WatertankSimulation, WatertankData, WatertankRequest> },
+        { "butterfly", createRunner<FPGA_DE1SoC_ButterflySimulation, ButterflyData, ButterflyRequest> },
+        { "butterfly-fpga-de1-soc", createRunner<FPGA_DE1SoC_ButterflySimulation, ButterflyData, ButterflyRequest> },
+        { "butterfly-fpga-de2-115", createRunner<FPGA_DE1SoC_ButterflySimulation, ButterflyData, ButterflyRequest> },
+        { "butterfly-stm32-wb55rg", createRunner<STM32_WB55RG_ButterflySimulation, ButterflyData, ButterflyRequest> },
+        { "door", createRunner<DoorSimulation, DoorData, DoorRequest> },
+        { "watertankDeusto", createRunner<WatertankDeustoSimulation, WatertankDeustoData, WatertankDeustoRequest> },
+        { "morse", createRunner<RHLab::Morse::MorseSimulation, RHLab::Morse::MorseData, RHLab::Morse::MorseRequest> },
+    };
+    return runners;
+}
+
+/*
+ * Host mode: runs the instances of a session manifest in this process (see SimulationHost). Each line of
+ * the manifest is "<instance> <simulation> [configuration]" (blank lines and lines starting with # are
+ * ignored). The backends of each instance are namespaced: its files, socket and log go to a directory
+ * named after the instance, and its shared memory is /hybridapi-<instance>.
+ */
+int runHost(const string & manifestFilename, map<string, string> & options) {
+    ifstream manifest(manifestFilename);
+    if (!manifest.is_open()) {
+        cerr << "Could not open the manifest " << manifestFilename << endl;
+        return 1;
+    }
+
+    SimulationHost host(options.count("threads") > 0 ? stoul(options["threads"]) : 0);
+    string line;
+    int lineNumber = 0;
+    while (getline(manifest, line)) {
+        lineNumber++;
+        istringstream fields(line);
+        string instance, simulation, configuration = "files";
+        if (!(fields >> instance) || instance[0] == '#')
+            continue;
+        fields >> simulation >> configuration;
+
+        bool validName = all_of(instance.begin(), instance.end(), [](char c) { return isalnum((unsigned char)c) || c == '-' || c == '_'; });
+        auto factory = getSimulationRunners().find(simulation);
+        if (!validName || factory == getSimulationRunners().end()) {
+            cerr << manifestFilename << ":" << lineNumber << ": invalid instance '" << instance << "' or simulation '" << simulation << "'" << endl;
+            return 2;
+        }
+
+        if (mkdir(instance.c_str(), 0755) != 0 && errno != EEXIST) {
+            perror(("Could not create the directory of " + instance).c_str());
+            return 1;
+        }
+
+        unique_ptr<SimulationRunner> runner = factory->second(configuration, "run", options);
+        if (!runner->setUp(instance, "/hybridapi-" + instance, host.getTimeManager()))
+            return 1;
+        host.add(instance, move(runner));
+    }
+
+    if (host.size() == 0) {
+        cerr << "No simulation instances in " << manifestFilename << endl;
+        return 1;
+    }
+
+    cout << "Hosting " << host.size() << " simulation instances on " << host.getThreadCount() << " threads" << endl;
+    host.start();
+
+    // Print the per-instance stats every --stats-interval seconds (10 by default, 0 to disable), and the
+    // jitter histogram of all the instances on SIGUSR1 and at exit (SIGINT or SIGTERM)
+    uint64_t statsInterval = options.count("stats-interval") > 0 ? stoull(options["stats-interval"]) : 10;
+    auto nextStats = chrono::steady_clock::now() + chrono::seconds(statsInterval);
+    while (!stopRequested) {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        if (statsInterval > 0 && chrono::steady_clock::now() >= nextStats) {
+            host.printStats(cout);
+            host.resetStats();
+            nextStats += chrono::seconds(statsInterval);
+        }
+        if (jitterReportRequested) {
+            jitterReportRequested = 0;
+            writeJitterReport(host.getJitterHistogram(), options);
+        }
+    }
+    host.stop();
+    writeJitterReport(host.getJitterHistogram(), options);
+    return 0;
+}
+
 int main(int argc, char * argv[]) {
     if (argc == 1) {
         cerr << "No simulation requested. Run " << argv[0] << " <simulation>" << endl;
         return 1;
     }
 
-    string simulation(argv[1]);
+    // Positional arguments first, then options like --async-reports or --key=value
+    vector<string> arguments;
+    map<string, string> options;
+    for (int i = 1; i < argc; i++) {
+        string argument(argv[i]);
+        if (argument.compare(0, 2, "--") == 0) {
+            size_t posEquals = argument.find('=');
+            if (posEquals == string::npos)
+                options[argument.substr(2)] = "1";
+            else
+                options[argument.substr(2, posEquals - 2)] = argument.substr(posEquals + 1);
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+
+    if (arguments.empty()) {
+        cerr << "No simulation requested. Run " << argv[0] << " <simulation>" << endl;
+        return 1;
+    }
+
+    // Scheduling settings of the process (inherited by the threads of the host mode)
+    if (options.count("cpu") > 0)
+        LabsLand::Utils::Realtime::pinToCpu(stoi(options["cpu"]));
+    if (options.count("nice") > 0)
+        LabsLand::Utils::Realtime::setNiceLevel(stoi(options["nice"]));
+    if (options.count("sched-fifo") > 0)
+        LabsLand::Utils::Realtime::setFifoPriority(stoi(options["sched-fifo"]));
+    if (options.count("mlock") > 0)
+        LabsLand::Utils::Realtime::lockMemory();
+
+    string simulation = arguments[0];
+    if (simulation == "bench") {
+        return runBenchmark(arguments.size() >= 2 ? arguments[1] : "all");
+    }
+
+    // For every mode, so SIGUSR1 never kills the process (see the loops of the modes for what they do)
+    signal(SIGUSR1, onJitterReportSignal);
+    signal(SIGINT, onStopSignal);
+    signal(SIGTERM, onStopSignal);
+
+    if (simulation == "host") {
+        if (arguments.size() < 2) {
+            cerr << "No manifest provided. Run " << argv[0] << " host <manifest>" << endl;
+            return 1;
+        }
+        return runHost(arguments[1], options);
+    }
+
     string configuration;
-    if (argc >= 3) {
-        configuration = argv[2];
+    if (arguments.size() >= 2) {
+        configuration = arguments[1];
     } else {
         configuration = "files";
     }
     string mode;
-    if (argc >= 4) {
-        mode = argv[3];
+    if (arguments.size() >= 3) {
+        mode = arguments[2];
     } else {
         mode = "run";
     }
 
-    SimulationRunner * runner = 0;
-
-    if (simulation == "matrix") {
-        runner = new ConcreteSimulationRunner<RHLab::LEDMatrix::MatrixSimulation, RHLab::LEDMatrix::MatrixData, RHLab::LEDMatrix::MatrixRequest>(configuration, mode);
-    } else if (simulation == "watertank") {
-        runner = new ConcreteSimulationRunner<WatertankSimulation, WatertankData, WatertankRequest>(configuration, mode);
-    } else if (simulation == "butterfly" || simulation == "butterfly-fpga-de1-soc" || simulation == "butterfly-fpga-de2-115") {
-        runner = new ConcreteSimulationRunner<FPGA_DE1SoC_ButterflySimulation, ButterflyData, ButterflyRequest>(configuration, mode);
-    } else if (simulation == "butterfly-stm32-wb55rg") {
-        runner = new ConcreteSimulationRunner<STM32_WB55RG_ButterflySimulation, ButterflyData, ButterflyRequest>(configuration, mode);
-    } else if (simulation == "door") {
-        runner = new ConcreteSimulationRunner<DoorSimulation, DoorData, DoorRequest>(configuration, mode);
-    } else if (simulation == "watertankDeusto") {
-        runner = new ConcreteSimulationRunner<WatertankDeustoSimulation, WatertankDeustoData, WatertankDeustoRequest>(configuration, mode);
-    } else if (simulation == "morse") {
-        runner = new ConcreteSimulationRunner< RHLab::Morse::MorseSimulation, RHLab::Morse::MorseData, RHLab::Morse::MorseRequest>(configuration, mode);
-    }
-    else {
+    auto factory = getSimulationRunners().find(simulation);
+    if (factory == getSimulationRunners().end()) {
         cerr << "Invalid simulation: '" << simulation << "'. Use a valid name" << endl;
         return 2;
     }
 
+    unique_ptr<SimulationRunner> runner = factory->second(configuration, mode, options);
+    if (!runner->setUp())
+        return 1;
     runner->run();
 
     return 0;
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#include <chrono>
+#include <iomanip>
+#include <time.h>
+
+#include "simulationhost.h"
+
+using namespace std;
+
+namespace {
+
+    uint64_t threadCpuNs() {
+        struct timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+    }
+}
+
+SimulationHost::SimulationHost(size_t threads):
+    threadCount(threads > 0 ? threads : max(1u, thread::hardware_concurrency())),
+    timeManager(make_shared<LabsLand::Utils::TimeManagerStd>()) {
+    for (size_t i = 0; i < threadCount; i++)
+        readyQueues.push_back(make_unique<ReadyQueue>());
+}
+
+SimulationHost::~SimulationHost() {
+    stop();
+}
+
+void SimulationHost::add(const string & name, unique_ptr<HostedSimulation> simulation) {
+    unique_ptr<Instance> instance = make_unique<Instance>();
+    instance->name = name;
+    instance->stepUs = simulation->getStepUs() > 0 ? simulation->getStepUs() : 100000;
+    instance->simulation = move(simulation);
+    instance->deadline = timeManager->getAbsoluteTime();
+
+    lock_guard<mutex> lock(deadlinesMutex);
+    deadlines.push({ instance->deadline, instance.get() });
+    instances.push_back(move(instance));
+}
+
+void SimulationHost::start() {
+    if (running.exchange(true))
+        return;
+
+    statsStart = timeManager->getAbsoluteTime();
+    for (size_t worker = 0; worker < threadCount; worker++)
+        workers.emplace_back(&SimulationHost::work, this, worker);
+}
+
+void SimulationHost::stop() {
+    if (!running.exchange(false))
+        return;
+
+    {
+        lock_guard<mutex> lock(deadlinesMutex);
+        deadlinesChanged.notify_all();
+    }
+    for (thread & worker : workers)
+        worker.join();
+    workers.clear();
+}
+
+/*
+ * The last instance queued by this worker or, if there is none, the oldest one of another worker.
+ */
+SimulationHost::Instance * SimulationHost::takeReady(size_t worker) {
+    if (readyInstances.load(memory_order_acquire) == 0)
+        return nullptr;
+
+    for (size_t i = 0; i < threadCount; i++) {
+        ReadyQueue & queue = *readyQueues[(worker + i) % threadCount];
+        lock_guard<mutex> lock(queue.mutex);
+        if (queue.instances.empty())
+            continue;
+
+        Instance * instance;
+        if (i == 0) {
+            instance = queue.instances.back();
+            queue.instances.pop_back();
+        } else {
+            instance = queue.instances.front();
+            queue.instances.pop_front();
+        }
+        readyInstances.fetch_sub(1, memory_order_release);
+        return instance;
+    }
+    return nullptr;
+}
+
+/*
+ * Moves the instances whose deadline passed to the queue of this worker. If there are none,
+ * waits until the next deadline (or until the deadlines change). Returns whether any was moved.
+ */
+bool SimulationHost::takeDue(size_t worker) {
+    unique_lock<mutex> lock(deadlinesMutex);
+    LabsLand::Utils::clock_t now = timeManager->getAbsoluteTime();
+
+    size_t due = 0;
+    while (!deadlines.empty() && deadlines.top().deadline <= now) {
+        Instance * instance = deadlines.top().instance;
+        deadlines.pop();
+
+        ReadyQueue & queue = *readyQueues[worker];
+        lock_guard<mutex> queueLock(queue.mutex);
+        queue.instances.push_back(instance);
+        readyInstances.fetch_add(1, memory_order_release);
+        due++;
+    }
+
+    if (due > 1) {
+        // Let the idle workers steal them
+        deadlinesChanged.notify_all();
+    }
+    if (due > 0)
+        return true;
+
+    if (!running.load())
+        return false;
+    if (deadlines.empty())
+        deadlinesChanged.wait(lock);
+    else
+        deadlinesChanged.wait_for(lock, chrono::microseconds(deadlines.top().deadline - now));
+    return false;
+}
+
+void SimulationHost::runTick(Instance * instance) {
+    LabsLand::Utils::clock_t start = timeManager->getAbsoluteTime();
+    {
+        lock_guard<mutex> lock(jitterMutex);
+        jitter.record(start > instance->deadline ? start - instance->deadline : 0);
+    }
+
+    uint64_t cpuStart = threadCpuNs();
+    instance->simulation->tick();
+    uint64_t cpuNs = threadCpuNs() - cpuStart;
+
+    instance->ticks.fetch_add(1, memory_order_relaxed);
+    instance->cpuNs.fetch_add(cpuNs, memory_order_relaxed);
+    if (cpuNs > instance->maxTickCpuNs.load(memory_order_relaxed))
+        instance->maxTickCpuNs.store(cpuNs, memory_order_relaxed);
+
+    // Next deadline, skipping the ones missed (as TickScheduler does)
+    LabsLand::Utils::clock_t now = timeManager->getAbsoluteTime();
+    LabsLand::Utils::clock_t next = instance->deadline + instance->stepUs;
+    if (now >= next) {
+        instance->overruns.fetch_add(1, memory_order_relaxed);
+        next += ((now - next) / instance->stepUs + 1) * instance->stepUs;
+    }
+
+    // Fairness: if other instances are waiting for a thread, an instance above its share of the CPU
+    // waits until its last update is within the share (it used cpu out of cpu / share of the time)
+    double share = (double)threadCount / instances.size();
+    if (share < 1 && readyInstances.load(memory_order_acquire) > 0) {
+        LabsLand::Utils::clock_t throttledUntil = now + (LabsLand::Utils::clock_t)(cpuNs / 1000 * (1 / share - 1));
+        if (throttledUntil > next) {
+            instance->throttledUs.fetch_add(throttledUntil - next, memory_order_relaxed);
+            next = throttledUntil;
+        }
+    }
+    instance->deadline = next;
+
+    lock_guard<mutex> lock(deadlinesMutex);
+    bool earliest = deadlines.empty() || next < deadlines.top().deadline;
+    deadlines.push({ next, instance });
+    if (earliest)
+        deadlinesChanged.notify_one();
+}
+
+LabsLand::Utils::JitterHistogram SimulationHost::getJitterHistogram() {
+    lock_guard<mutex> lock(jitterMutex);
+    return jitter;
+}
+
+void SimulationHost::work(size_t worker) {
+    while (running.load(memory_order_relaxed)) {
+        Instance * instance = takeReady(worker);
+        if (instance == nullptr) {
+            takeDue(worker);
+            continue;
+        }
+        runTick(instance);
+    }
+}
+
+void SimulationHost::printStats(ostream & output) {
+    double seconds = (timeManager->getAbsoluteTime() - statsStart) / 1e6;
+    output << "Host: " << instances.size() << " instances on " << threadCount << " threads, last " << seconds << " s" << endl;
+    for (const unique_ptr<Instance> & instance : instances) {
+        uint64_t ticks = instance->ticks.load(memory_order_relaxed);
+        double cpuMs = instance->cpuNs.load(memory_order_relaxed) / 1e6;
+        output << "  " << left << setw(16) << instance->name << right
+               << " ticks " << setw(8) << ticks << " (" << (seconds > 0 ? ticks / seconds : 0) << " Hz, step " << instance->stepUs << " us)"
+               << "; CPU " << cpuMs << " ms (" << (seconds > 0 ? cpuMs / 10 / seconds : 0) << "%)"
+               << ", max " << instance->maxTickCpuNs.load(memory_order_relaxed) / 1000 << " us per tick"
+               << "; " << instance->overruns.load(memory_order_relaxed) << " overruns"
+               << ", throttled " << instance->throttledUs.load(memory_order_relaxed) / 1000 << " ms" << endl;
+    }
+}
+
+void SimulationHost::resetStats() {
+    statsStart = timeManager->getAbsoluteTime();
+    for (unique_ptr<Instance> & instance : instances) {
+        instance->ticks.store(0, memory_order_relaxed);
+        instance->cpuNs.store(0, memory_order_relaxed);
+        instance->maxTickCpuNs.store(0, memory_order_relaxed);
+        instance->overruns.store(0, memory_order_relaxed);
+        instance->throttledUs.store(0, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef HYBRIDAPI_SIMULATION_HOST_H
+#define HYBRIDAPI_SIMULATION_HOST_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "labsland/utils/timemanagerstd.h"
+#include "labsland/utils/jitterhistogram.h"
+
+/*
+ * A simulation instance, with its backends already set up, that a SimulationHost updates
+ * periodically (see ConcreteSimulationRunner in main.cpp).
+ */
+class HostedSimulation {
+    public:
+        virtual ~HostedSimulation() {}
+
+        // One update of the simulation (Simulation::_update())
+        virtual void tick() = 0;
+
+        // Time between updates, in microseconds
+        virtual uint64_t getStepUs() = 0;
+};
+
+/*
+ * Runs many simulation instances in one process, on a fixed pool of threads (one per core by
+ * default) instead of one process busy-waiting per session.
+ *
+ * Each instance is updated every step, with absolute deadlines like TickScheduler. Instances that
+ * are due are pushed to the queue of the thread that found them; each thread takes the instances
+ * of its own queue and, when it is empty, steals them from the other queues, so a thread stuck in
+ * a long update does not hold back the instances queued behind it.
+ *
+ * The CPU time (of the thread) used by each update is accounted to its instance. While other
+ * instances are waiting for a thread, an instance that used more than its fair share of the CPU
+ * (threads / instances) is delayed until it is back to it, so a runaway simulation (e.g., a busy
+ * loop in update()) cannot starve its neighbors. An update in progress is never interrupted.
+ *
+ * How late every update starts compared with its deadline is recorded in a histogram shared by
+ * all the instances (see getJitterHistogram()).
+ */
+class SimulationHost {
+    private:
+        struct Instance {
+            std::string name;
+            std::unique_ptr<HostedSimulation> simulation;
+            uint64_t stepUs;
+            LabsLand::Utils::clock_t deadline;
+
+            // Written by the thread that runs the instance, read by printStats()
+            std::atomic<uint64_t> ticks = { 0 };
+            std::atomic<uint64_t> cpuNs = { 0 };
+            std::atomic<uint64_t> maxTickCpuNs = { 0 };
+            std::atomic<uint64_t> overruns = { 0 };
+            std::atomic<uint64_t> throttledUs = { 0 };
+        };
+
+        struct Deadline {
+            LabsLand::Utils::clock_t deadline;
+            Instance * instance;
+
+            bool operator>(const Deadline & other) const {
+                return deadline > other.deadline;
+            }
+        };
+
+        // Instances ready to run, per thread: the owner takes from the back, thieves from the front
+        struct ReadyQueue {
+            std::mutex mutex;
+            std::deque<Instance *> instances;
+        };
+
+        const size_t threadCount;
+        // Shared with the instances (see getTimeManager())
+        std::shared_ptr<LabsLand::Utils::TimeManagerStd> timeManager;
+
+        std::vector<std::unique_ptr<Instance>> instances;
+        std::vector<std::unique_ptr<ReadyQueue>> readyQueues;
+        std::atomic<size_t> readyInstances = { 0 };
+
+        // Instances waiting for their deadline
+        std::mutex deadlinesMutex;
+        std::condition_variable deadlinesChanged;
+        std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines;
+
+        std::atomic<bool> running = { false };
+        std::vector<std::thread> workers;
+        LabsLand::Utils::clock_t statsStart = 0;
+
+        std::mutex jitterMutex;
+        LabsLand::Utils::JitterHistogram jitter;
+
+        Instance * takeReady(size_t worker);
+        bool takeDue(size_t worker);
+        void runTick(Instance * instance);
+        void work(size_t worker);
+
+    public:
+        /*
+         * threads: size of the pool (0 for one per core).
+         */
+        SimulationHost(size_t threads = 0);
+        ~SimulationHost();
+
+        void add(const std::string & name, std::unique_ptr<HostedSimulation> simulation);
+
+        size_t size() const {
+            return instances.size();
+        }
+
+        size_t getThreadCount() const {
+            return threadCount;
+        }
+
+        std::shared_ptr<LabsLand::Utils::TimeManagerStd> getTimeManager() const {
+            return timeManager;
+        }
+
+        void start();
+        void stop();
+
+        /*
+         * Per-instance ticks and CPU usage since the host started (or the stats were reset).
+         */
+        void printStats(std::ostream & output);
+        void resetStats();
+
+        /*
+         * Lateness of the updates of all the instances since the host started.
+         */
+        LabsLand::Utils::JitterHistogram getJitterHistogram();
+};
+
+#endif
@@ -10,30 +10,33 @@ void DoorSimulation::initialize()
         {"open", "close"});
 
     setReportWhenMarked(true);
+    // The door only reacts to the GPIOs and to the requests, which set the sensors as soon as they arrive
+    setEventDriven(true);
+    setDispatchRequests(true);
 }
 
-void DoorSimulation::update(double delta)
+void DoorSimulation::onRequest(const DoorRequest &request)
 {
+    this->log() << "Input:" << std::endl
+                << " Opened: " << request.doorOpened << "; Closed: " << request.doorClosed << "; Person waiting: " << request.personSensor << std::endl;
 
-    this->log() << "Updating simulation. Delta: " << delta << std::endl;
+    this->targetDevice->setGpio("doorOpened", request.doorOpened);
+    this->targetDevice->setGpio("doorClosed", request.doorClosed);
+    this->targetDevice->setGpio("personSensor", request.personSensor);
 
-    DoorRequest request;
-    bool requestWasRead = readRequest(request);
+    requestReportState();
+}
 
-    mState.open = this->targetDevice->getGpio("open");
-    mState.close = this->targetDevice->getGpio("close");
+void DoorSimulation::update(double delta)
+{
 
-    this->log() << std::endl
-                << "Open door: " << mState.open << "; Close door: " << mState.close << std::endl;
+    LL_LOG(Debug) << "Updating simulation. Delta: " << delta << std::endl;
 
-    if (requestWasRead) {
-        this->log() << "Input:" << std::endl
-                    << " Opened: " << request.doorOpened << "; Closed: " << request.doorClosed << "; Person waiting: " << request.personSensor << std::endl;
+    mState.open = this->targetDevice->getGpio("open");
+    mState.close = this->targetDevice->getGpio("close");
 
-        this->targetDevice->setGpio("doorOpened", request.doorOpened);
-        this->targetDevice->setGpio("doorClosed", request.doorClosed);
-        this->targetDevice->setGpio("personSensor", request.personSensor);
-    }
+    LL_LOG(Debug) << std::endl
+                  << "Open door: " << mState.open << "; Close door: " << mState.close << std::endl;
 
     requestReportState();
 }
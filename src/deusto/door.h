@@ -13,11 +13,26 @@ struct DoorData : public BaseOutputDataType
     bool open;
     bool close;
 
+    static constexpr auto fields()
+    {
+        using namespace LabsLand::Simulations::Utils;
+        return describeFields(field("open", &DoorData::open), field("close", &DoorData::close));
+    }
+
+    // "<open>&<close>&"
     std::string serialize() const
     {
-        std::stringstream stream;
-        stream << open << "&" << close << "&";
-        return stream.str();
+        return serializeToString();
+    }
+
+    size_t serializeTo(char *buffer, size_t size) const override
+    {
+        return LabsLand::Simulations::Utils::writeValueList(*this, buffer, size);
+    }
+
+    size_t serializeBinary(char *buffer, size_t size) const override
+    {
+        return LabsLand::Simulations::Utils::writeBinary(*this, buffer, size);
     }
 };
 
@@ -27,44 +42,19 @@ struct DoorRequest : public BaseInputDataType
     bool doorClosed;
     bool personSensor;
 
+    static constexpr auto fields()
+    {
+        using namespace LabsLand::Simulations::Utils;
+        return describeFields(
+            field("doorOpened", &DoorRequest::doorOpened),
+            field("doorClosed", &DoorRequest::doorClosed),
+            field("personSensor", &DoorRequest::personSensor));
+    }
+
+    // "<doorOpened>&<doorClosed>&<personSensor>", each of them 1 or 0
     bool deserialize(std::string const &input)
     {
-        std::stringstream stream(input);
-        std::string segment;
-        std::vector<std::string> segments;
-
-        while (std::getline(stream, segment, '&'))
-        {
-            segments.push_back(segment);
-        }
-
-        if (segments.size() != 3)
-        {
-            return false;
-        }
-
-        if (segments[0] == "1")
-            doorOpened = true;
-        else if (segments[0] == "0")
-            doorOpened = false;
-        else
-            return false;
-
-        if (segments[1] == "1")
-            doorClosed = true;
-        else if (segments[1] == "0")
-            doorClosed = false;
-        else
-            return false;
-
-        if (segments[2] == "1")
-            personSensor = true;
-        else if (segments[2] == "0")
-            personSensor = false;
-        else
-            return false;
-
-        return true;
+        return LabsLand::Simulations::Utils::readValueList(*this, input.data(), input.size());
     }
 };
 
@@ -76,6 +66,8 @@ public:
 
     virtual void update(double delta) override;
 
+    virtual void onRequest(const DoorRequest &request) override;
+
     virtual void initialize() override;
 };
 
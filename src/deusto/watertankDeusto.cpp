@@ -1,6 +1,7 @@
  #include <string>
  #include <iostream>
  #include <cmath>
+ #include <algorithm>
  #include "watertankDeusto.h"
  
  
@@ -21,63 +22,40 @@
      mState.pump2Active = true;
  
      setReportWhenMarked(true);
+     // Integrate the physics in 10 ms steps, catching up at most 0.5 s after a stall
+     setFixedTimestep(0.01, 50);
  }
  
  int error[4][3] = {{ 0, 1, 0 },{ 1, 0, 0 },{ 1, 0, 1 },{ 1, 1, 0 }};
-  void WatertankDeustoSimulation::update(double delta) {
- 
-     this->log() << "Updating simulation. Delta: " << delta << std::endl;
- 
-     WatertankDeustoRequest request;
-     bool requestWasRead = readRequest(request);
-     if (requestWasRead) {
-          mCurrentDemandFlowrate = request.outputFlow;
-          makeError = request.makeError;
-          resetError = request.resetError;
-     }
- 
-     double addedWater = 0;
 
-     if (mState.pump1Temperature>=85) mState.pump1Hot = true;
-     else mState.pump1Hot = false;
-     if (mState.pump2Temperature>=85) mState.pump2Hot = true;
-     else mState.pump2Hot = false;
+ /*
+  * Integrates the temperatures and the volume of the tank, with the pumps and demand read in the last update().
+  */
+ void WatertankDeustoSimulation::step(double dt) {
 
-     if (mState.pump1Temperature>=100) mState.pump1Broken = true;
-     else mState.pump1Broken = false;
-     if (mState.pump2Temperature>=100) mState.pump2Broken = true;
-     else mState.pump2Broken = false;
+     double addedWater = 0;
 
-     mState.pump1Active = this->targetDevice->getGpio("pump1");
-     mState.pump2Active = this->targetDevice->getGpio("pump2");
- 
-     this->log() << "Pumps: pump1: " << mState.pump1Active << "; pump2: " << mState.pump2Active << std::endl;
- 
-     if(mState.pump1Active) {
-        if(mState.pump1Temperature<100) mState.pump1Temperature += 6 * delta;
-        else mState.pump1Temperature = 100;
+     mState.pump1Hot = mState.pump1Temperature >= 85;
+     mState.pump2Hot = mState.pump2Temperature >= 85;
+     mState.pump1Broken = mState.pump1Temperature >= 100;
+     mState.pump2Broken = mState.pump2Temperature >= 100;
 
-        if(!mState.pump1Broken) addedWater += PUMP1_FLOWRATE * delta;
+     if(mState.pump1Active) {
+        mState.pump1Temperature = std::min(mState.pump1Temperature + 6 * dt, 100.0);
+        if(!mState.pump1Broken) addedWater += PUMP1_FLOWRATE * dt;
      }else{
-        if(mState.pump1Temperature>0) mState.pump1Temperature -= 6 * delta;
-        else mState.pump1Temperature = 0;
+        mState.pump1Temperature = std::max(mState.pump1Temperature - 6 * dt, 0.0);
      }
- 
-     if(mState.pump2Active) {
-        if(mState.pump2Temperature<100) mState.pump2Temperature += 6 * delta;
-        else mState.pump2Temperature = 100;
 
-        if(!mState.pump2Broken) addedWater += PUMP2_FLOWRATE * delta;
+     if(mState.pump2Active) {
+        mState.pump2Temperature = std::min(mState.pump2Temperature + 6 * dt, 100.0);
+        if(!mState.pump2Broken) addedWater += PUMP2_FLOWRATE * dt;
      }else{
-        if(mState.pump2Temperature>0) mState.pump2Temperature -= 6 * delta;
-        else mState.pump2Temperature = 0;
+        mState.pump2Temperature = std::max(mState.pump2Temperature - 6 * dt, 0.0);
      }
- 
-     float removedWater = 0;
-     removedWater = mCurrentDemandFlowrate * delta;
- 
-     this->log() << "Old volume: " << mState.volume << "; adding: " << addedWater << "; removing (flow rate=" << mCurrentDemandFlowrate << "): " << removedWater << std::endl;
- 
+
+     double removedWater = mCurrentDemandFlowrate * dt;
+
      mState.volume = mState.volume + addedWater - removedWater;
      if (mState.volume < 0) {
          mState.volume = 0;
@@ -85,8 +63,27 @@
      if (mState.volume > mState.totalVolume) {
          mState.volume = mState.totalVolume;
      }
- 
+
      mState.level = mState.volume / mState.totalVolume;
+ }
+
+  void WatertankDeustoSimulation::update(double delta) {
+ 
+     LL_LOG(Debug) << "Updating simulation. Delta: " << delta << std::endl;
+ 
+     WatertankDeustoRequest request;
+     bool requestWasRead = readRequest(request);
+     if (requestWasRead) {
+          mCurrentDemandFlowrate = request.outputFlow;
+          makeError = request.makeError;
+          resetError = request.resetError;
+     }
+
+     // The physics were already integrated up to now by step(); the pumps read here apply from the next step
+     mState.pump1Active = this->targetDevice->getGpio("pump1");
+     mState.pump2Active = this->targetDevice->getGpio("pump2");
+ 
+     LL_LOG(Debug) << "Pumps: pump1: " << mState.pump1Active << "; pump2: " << mState.pump2Active << std::endl;
      
      if(resetError && isBroken){
             isBroken = false;
@@ -101,14 +98,14 @@
             mState.highSensorActive = error[randomError][0];
       }
      
-     this->log() << "New volume: " << mState.volume << "; which is level=" << mState.level << std::endl;
+     LL_LOG(Debug) << "Volume: " << mState.volume << "; which is level=" << mState.level << " (flow rate=" << mCurrentDemandFlowrate << ")" << std::endl;
      if(!isBroken)
      {
         mState.lowSensorActive = mState.level >= 0.20;
         mState.midSensorActive = mState.level >= 0.50;
         mState.highSensorActive = mState.level >= 0.80;
      }
-     this->log() << "Sensors: Low (0.2): " << mState.lowSensorActive << "; Mid (0.5): " << mState.midSensorActive << "; High (0.8): " << mState.highSensorActive << std::endl;
+     LL_LOG(Debug) << "Sensors: Low (0.2): " << mState.lowSensorActive << "; Mid (0.5): " << mState.midSensorActive << "; High (0.8): " << mState.highSensorActive << std::endl;
  
      this->targetDevice->setGpio("lowSensorActive", mState.lowSensorActive);
      this->targetDevice->setGpio("midSensorActive", mState.midSensorActive);
@@ -116,11 +113,7 @@
      this->targetDevice->setGpio("pump1Hot", mState.pump1Hot);
      this->targetDevice->setGpio("pump2Hot", mState.pump2Hot);
      
-     this->log() << "of: " << request.outputFlow << "; err: " << request.makeError << "; res: " << request.resetError << std::endl;
+     LL_LOG(Debug) << "of: " << request.outputFlow << "; err: " << request.makeError << "; res: " << request.resetError << std::endl;
 
      requestReportState();
  }
-
-
- 
- 
\ No newline at end of file
@@ -25,13 +25,37 @@
      bool pump1Broken;
      bool pump2Broken;
 
+     static constexpr auto fields() {
+         using namespace LabsLand::Simulations::Utils;
+         return describeFields(
+             field("level", &WatertankDeustoData::level),
+             field("totalVolume", &WatertankDeustoData::totalVolume),
+             field("volume", &WatertankDeustoData::volume),
+             field("pump1Active", &WatertankDeustoData::pump1Active),
+             field("pump2Active", &WatertankDeustoData::pump2Active),
+             field("pump1Temperature", &WatertankDeustoData::pump1Temperature),
+             field("pump2Temperature", &WatertankDeustoData::pump2Temperature),
+             field("currentLoad", &WatertankDeustoData::currentLoad),
+             field("lowSensorActive", &WatertankDeustoData::lowSensorActive),
+             field("midSensorActive", &WatertankDeustoData::midSensorActive),
+             field("highSensorActive", &WatertankDeustoData::highSensorActive),
+             field("pump1Hot", &WatertankDeustoData::pump1Hot),
+             field("pump2Hot", &WatertankDeustoData::pump2Hot),
+             field("pump1Broken", &WatertankDeustoData::pump1Broken),
+             field("pump2Broken", &WatertankDeustoData::pump2Broken)
+         );
+     }
+
      std::string serialize() const {
-         std::stringstream stream;
-         stream << level << "&" << totalVolume << "&" << volume << "&" << pump1Active << "&" << pump2Active << "&" <<
-             pump1Temperature << "&" << pump2Temperature << "&" << currentLoad << "&" << lowSensorActive << "&" <<
-             midSensorActive << "&" << highSensorActive << "&"<< pump1Hot << "&" << pump2Hot << "&" <<
-             pump1Broken << "&" << pump2Broken << "&";
-         return stream.str();
+         return serializeToString();
+     }
+
+     size_t serializeTo(char * buffer, size_t size) const override {
+         return LabsLand::Simulations::Utils::writeValueList(*this, buffer, size);
+     }
+
+     size_t serializeBinary(char * buffer, size_t size) const override {
+         return LabsLand::Simulations::Utils::writeBinary(*this, buffer, size);
      }
  };
  
@@ -39,17 +63,22 @@
      float outputFlow;
      bool makeError;
      bool resetError;
+
+     static constexpr auto fields() {
+         using namespace LabsLand::Simulations::Utils;
+         return describeFields(
+             field("outputFlow", &WatertankDeustoRequest::outputFlow),
+             field("makeError", &WatertankDeustoRequest::makeError),
+             field("resetError", &WatertankDeustoRequest::resetError)
+         );
+     }
+
+     // "<outputFlow>&<makeError>&<resetError>" (the flow might use a decimal comma)
      bool deserialize(std::string const & input) {
-        std::string data = input;
-        std::replace(data.begin(), data.end(), '&', ' ');
-        std::replace(data.begin(), data.end(), ',', '.');
-        std::stringstream stream(data);
-        int errorInt, resetInt;
-        if (!(stream >> outputFlow >> errorInt >> resetInt)) {
+        if (!LabsLand::Simulations::Utils::readValueList(*this, input.data(), input.size(), true)) {
             return false; 
         }
-        makeError = (errorInt != 0);
-        resetError = (resetInt != 0) && !makeError;
+        resetError = resetError && !makeError;
 
         return true;
     }
@@ -76,6 +105,8 @@
      WatertankDeustoSimulation() = default;
  
      virtual void update(double delta) override;
+
+     virtual void step(double dt) override;
  
      virtual void initialize() override;
  };
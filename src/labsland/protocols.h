@@ -8,6 +8,9 @@
 #ifndef LL_PROTOCOLS_H
 #define LL_PROTOCOLS_H
 
+#include <cstddef>
+#include <vector>
+
 /*
  * In this file we keep utilities for interacting with certain protocols, such as
  * GPIO, I2C or in the future any other (SPI...)
@@ -38,8 +41,31 @@ namespace LabsLand::Protocols {
     //
 
     class I2C_IO_Wrapper {
-        virtual unsigned char readByte() = 0;
-        virtual void writeByte(unsigned char byte) = 0;
+        public:
+            virtual ~I2C_IO_Wrapper() {}
+
+            /*
+             * Reads up to length of the bytes sent by the master, in one burst. Returns how many were read.
+             */
+            virtual size_t readBytes(unsigned char * data, size_t length) = 0;
+
+            /*
+             * Sends length bytes to the master, in one burst. Returns how many were sent.
+             */
+            virtual size_t writeBytes(const unsigned char * data, size_t length) = 0;
+
+            /*
+             * One byte sent by the master (0 if there is none).
+             */
+            unsigned char readByte() {
+                unsigned char byte = 0;
+                readBytes(&byte, 1);
+                return byte;
+            }
+
+            void writeByte(unsigned char byte) {
+                writeBytes(&byte, 1);
+            }
     };
 
     enum I2CEventType {
@@ -63,17 +89,189 @@ namespace LabsLand::Protocols {
             const unsigned int getAddress() { return this->address; }
     };
 
+    /*
+     * A device on a shared I2C bus, served by an I2CRouter (so many devices do not need a callback
+     * and a channel each).
+     */
+    class I2CSlaveHandler {
+        public:
+            virtual ~I2CSlaveHandler() {}
+
+            /*
+             * The master wrote length bytes to this slave, in one transaction.
+             */
+            virtual void onReceive(const unsigned char * data, size_t length) = 0;
+
+            /*
+             * The master reads length bytes from this slave: fill data with them. Returns how many were filled
+             * (the rest are not sent).
+             */
+            virtual size_t onRequest(unsigned char * data, size_t length) = 0;
+
+            /*
+             * The master released the bus (stop condition) after addressing this slave.
+             */
+            virtual void onFinish() {}
+
+            /*
+             * Whether it answers to its address now (e.g., an EEPROM does not during its write cycle).
+             */
+            virtual bool isReady() { return true; }
+    };
+
+    /**
+     * Serves any number of I2C slaves from a single channel (one callback, one thread), with a flat table
+     * indexed by the 7-bit address.
+     *
+     * Every transaction starts with the address byte, as on the wire: (address << 1) | R/W. In a receive,
+     * the rest of the input is what the master writes, and it is passed to the slave at once. In a request,
+     * it may be followed by the number of bytes the master reads (2 bytes, big endian; DEFAULT_REQUEST_LENGTH
+     * otherwise), which the slave fills in one burst. Addresses without a slave (or whose slave is not ready)
+     * do not answer (NACK).
+     */
+    class I2CRouter {
+        public:
+            static const unsigned int ADDRESSES = 128;
+            static const size_t DEFAULT_REQUEST_LENGTH = 32;
+
+        private:
+            // Not destroyed by this class
+            I2CSlaveHandler * slaves[ADDRESSES] = {};
+            I2CSlaveHandler * addressedSlave = nullptr;
+            // Reused by every transaction, so it only allocates while it grows
+            std::vector<unsigned char> buffer;
+            unsigned long transactions = 0;
+            unsigned long nacks = 0;
+
+            void readRest(I2C_IO_Wrapper * bus) {
+                const size_t chunk = 256;
+                buffer.clear();
+                size_t received;
+                do {
+                    size_t previous = buffer.size();
+                    buffer.resize(previous + chunk);
+                    received = bus->readBytes(buffer.data() + previous, chunk);
+                    buffer.resize(previous + received);
+                } while (received == chunk);
+            }
+
+            /*
+             * Reads the address byte of a transaction and selects its slave (nullptr if there is none).
+             */
+            I2CSlaveHandler * address(I2C_IO_Wrapper * bus) {
+                unsigned char addressByte;
+                if (bus->readBytes(&addressByte, 1) != 1)
+                    return nullptr;
+                addressedSlave = slaves[addressByte >> 1];
+                if (addressedSlave != nullptr && !addressedSlave->isReady())
+                    addressedSlave = nullptr;
+                if (addressedSlave == nullptr)
+                    nacks++;
+                return addressedSlave;
+            }
+
+        public:
+            /*
+             * Returns false if the address is not valid or it is already taken.
+             */
+            bool addSlave(unsigned int address, I2CSlaveHandler * slave) {
+                if (address >= ADDRESSES || slave == nullptr || slaves[address] != nullptr)
+                    return false;
+                slaves[address] = slave;
+                return true;
+            }
+
+            void removeSlave(unsigned int address) {
+                if (address >= ADDRESSES)
+                    return;
+                if (addressedSlave == slaves[address])
+                    addressedSlave = nullptr;
+                slaves[address] = nullptr;
+            }
+
+            I2CSlaveHandler * getSlave(unsigned int address) const {
+                return address < ADDRESSES ? slaves[address] : nullptr;
+            }
+
+            /*
+             * Transactions served, and transactions to addresses without a slave.
+             */
+            unsigned long getTransactions() const { return this->transactions; }
+            unsigned long getNacks() const { return this->nacks; }
+
+            /*
+             * To be called with the events of the channel (as an i2cSlaveCallback would).
+             */
+            void handleEvent(I2C_IO_Wrapper * bus, I2CEventType event) {
+                switch (event) {
+                    case I2CEventType::slaveReceive: {
+                        I2CSlaveHandler * slave = address(bus);
+                        // The bytes are consumed even without a slave, so they are not taken for the next transaction
+                        readRest(bus);
+                        if (slave != nullptr) {
+                            slave->onReceive(buffer.data(), buffer.size());
+                            transactions++;
+                        }
+                        break;
+                    }
+                    case I2CEventType::slaveRequest: {
+                        I2CSlaveHandler * slave = address(bus);
+                        readRest(bus);
+                        if (slave == nullptr)
+                            break;
+                        size_t length = buffer.size() >= 2 ? ((size_t)buffer[0] << 8) | buffer[1] : DEFAULT_REQUEST_LENGTH;
+                        buffer.resize(length);
+                        size_t filled = slave->onRequest(buffer.data(), length);
+                        bus->writeBytes(buffer.data(), filled < length ? filled : length);
+                        transactions++;
+                        break;
+                    }
+                    case I2CEventType::slaveFinish:
+                        if (addressedSlave != nullptr)
+                            addressedSlave->onFinish();
+                        addressedSlave = nullptr;
+                        break;
+                    default:
+                        break;
+                }
+            }
+    };
+
     //
     //    SPI
     //
 
     class SPI_IO_Wrapper {
     public:
+        virtual ~SPI_IO_Wrapper() {}
+
+        // Sends length bytes in one burst. Returns how many were sent
+        virtual size_t writeBytes(const unsigned char * data, size_t length) = 0;
+
+        // Receives up to length bytes in one burst. Returns how many were received
+        virtual size_t readBytes(unsigned char * data, size_t length) = 0;
+
+        // Full duplex: sends the length bytes of tx while receiving into rx (bytes not received are
+        // left as 0). Returns how many were received
+        virtual size_t transfer(const unsigned char * tx, unsigned char * rx, size_t length) {
+            writeBytes(tx, length);
+            size_t received = readBytes(rx, length);
+            for (size_t i = received; i < length; i++)
+                rx[i] = 0;
+            return received;
+        }
+
         // Method to send a byte over MOSI
-        virtual void writeByte(unsigned char byte) = 0;
+        void writeByte(unsigned char byte) {
+            writeBytes(&byte, 1);
+        }
 
-        // Method to receive a byte from MISO
-        virtual unsigned char readByte() = 0;
+        // Method to receive a byte from MISO (0 if there is none)
+        unsigned char readByte() {
+            unsigned char byte = 0;
+            readBytes(&byte, 1);
+            return byte;
+        }
 
         // Might need further implementation: to handle chip select (CS/SS) control
         virtual void setChipSelect(bool state) = 0;
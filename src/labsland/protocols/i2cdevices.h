@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LL_I2C_DEVICES_H
+#define LL_I2C_DEVICES_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "i2cregisterdevice.h"
+
+/*
+ * Reference models of common I2C devices, built on I2CRegisterDevice. Add them to an I2CRouter at their
+ * DEFAULT_ADDRESS (or at the one selected by their address pins).
+ */
+namespace LabsLand::Protocols {
+
+    /**
+     * 24Cxx EEPROM: all the memory is read-write, writes wrap within a page and take a write cycle, during
+     * which the EEPROM does not answer. Erased bytes are 0xFF.
+     */
+    class I2CEEPROM : public I2CRegisterDevice {
+        public:
+            static const unsigned int DEFAULT_ADDRESS = 0x50;
+            static const uint32_t WRITE_CYCLE_US = 5000;
+
+            I2CEEPROM(size_t size, size_t pageSize, size_t pointerBytes, std::shared_ptr<LabsLand::Utils::TimeManager> timeManager):
+                I2CRegisterDevice(size, pointerBytes, 0xFF) {
+                this->setPageWrite(pageSize, WRITE_CYCLE_US, timeManager);
+            }
+    };
+
+    /*
+     * 2 Kbit (256 bytes), 8-byte pages, 1-byte word address.
+     */
+    class EEPROM24C02 : public I2CEEPROM {
+        public:
+            EEPROM24C02(std::shared_ptr<LabsLand::Utils::TimeManager> timeManager = nullptr): I2CEEPROM(256, 8, 1, timeManager) {}
+    };
+
+    /*
+     * 256 Kbit (32 KB), 64-byte pages, 2-byte word address.
+     */
+    class EEPROM24C256 : public I2CEEPROM {
+        public:
+            EEPROM24C256(std::shared_ptr<LabsLand::Utils::TimeManager> timeManager = nullptr): I2CEEPROM(32768, 64, 2, timeManager) {}
+    };
+
+    /**
+     * Temperature sensor in the style of the LM75, with byte registers:
+     *
+     * - 0x00-0x01 TEMPERATURE (read-only): signed 8.8 fixed point, in Celsius (MSB first).
+     * - 0x02 CONFIGURATION: bit 0 is shutdown (the temperature is not updated).
+     * - 0x03 STATUS (write one to clear): bit 0 when the temperature reached HIGH, bit 1 when it went below LOW.
+     * - 0x04 HIGH and 0x05 LOW: alert limits, signed, in Celsius (80 and -10 by default).
+     */
+    class TemperatureSensor : public I2CRegisterDevice {
+        public:
+            static const unsigned int DEFAULT_ADDRESS = 0x48;
+
+            static const size_t TEMPERATURE = 0x00;
+            static const size_t CONFIGURATION = 0x02;
+            static const size_t STATUS = 0x03;
+            static const size_t HIGH_LIMIT = 0x04;
+            static const size_t LOW_LIMIT = 0x05;
+
+            static const unsigned char SHUTDOWN = 0x01;
+            static const unsigned char ALERT_HIGH = 0x01;
+            static const unsigned char ALERT_LOW = 0x02;
+
+            TemperatureSensor(): I2CRegisterDevice(6) {
+                this->setAccess(TEMPERATURE, RegisterAccess::ReadOnly, 2);
+                this->setAccess(STATUS, RegisterAccess::WriteOneToClear);
+                this->registers[HIGH_LIMIT] = 80;
+                this->registers[LOW_LIMIT] = (unsigned char)-10;
+            }
+
+            /*
+             * The temperature measured by the sensor (from the simulation).
+             */
+            void setTemperature(double celsius) {
+                RegisterLock lock(*this);
+                if (this->registers[CONFIGURATION] & SHUTDOWN)
+                    return;
+
+                // The 8.8 fixed point goes from -128 to 127.996 degrees
+                long scaled = std::lround(celsius * 256);
+                int16_t fixedPoint = (int16_t)std::max(-32768L, std::min(32767L, scaled));
+                this->registers[TEMPERATURE] = (unsigned char)(fixedPoint >> 8);
+                this->registers[TEMPERATURE + 1] = (unsigned char)(fixedPoint & 0xFF);
+
+                int8_t degrees = (int8_t)this->registers[TEMPERATURE];
+                if (degrees >= (int8_t)this->registers[HIGH_LIMIT])
+                    this->registers[STATUS] |= ALERT_HIGH;
+                if (degrees < (int8_t)this->registers[LOW_LIMIT])
+                    this->registers[STATUS] |= ALERT_LOW;
+            }
+    };
+
+    /**
+     * PCF8574 8-bit IO expander: no register pointer, every byte written sets the output latch, and every
+     * byte read is the state of the pins. The pins are quasi-bidirectional: a pin reads low if its latch is
+     * 0 or if something outside pulls it low (setInputs()).
+     */
+    class PCF8574 : public I2CRegisterDevice {
+        private:
+            unsigned char latch = 0xFF;
+            unsigned char inputs = 0xFF;
+
+        protected:
+            virtual void onRegisterWritten(size_t address, unsigned char value) override {
+                this->latch = value;
+            }
+
+            virtual void beforeRequest() override {
+                this->registers[0] = this->latch & this->inputs;
+            }
+
+        public:
+            static const unsigned int DEFAULT_ADDRESS = 0x20;
+
+            PCF8574(): I2CRegisterDevice(1, 0, 0xFF) {
+                this->setAutoIncrement(false);
+            }
+
+            /*
+             * What is connected to the pins (from the simulation): bits at 0 pull the pin low.
+             */
+            void setInputs(unsigned char pins) {
+                RegisterLock lock(*this);
+                this->inputs = pins;
+            }
+
+            /*
+             * The output latch written by the master.
+             */
+            unsigned char getOutputs() {
+                RegisterLock lock(*this);
+                return this->latch;
+            }
+    };
+}
+
+#endif
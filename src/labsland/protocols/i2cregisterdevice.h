@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LL_I2C_REGISTER_DEVICE_H
+#define LL_I2C_REGISTER_DEVICE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "labsland/protocols.h"
+#include "labsland/utils/timemanager.h"
+
+namespace LabsLand::Protocols {
+
+    enum class RegisterAccess : unsigned char {
+        ReadWrite,
+        ReadOnly,        // writes from the master are ignored
+        WriteOneToClear  // the bits the master writes as 1 are cleared (e.g., interrupt flags)
+    };
+
+    /**
+     * An I2C device declared as a map of byte registers (e.g., an EEPROM, a sensor or an IO expander), to be
+     * added to an I2CRouter.
+     *
+     * As most of them, a write from the master starts with the register pointer (pointerBytes bytes, big endian;
+     * none for devices with a single register), followed by the bytes to write from there. A read starts at the
+     * pointer. With auto-increment, the pointer advances after every byte: reads roll over the whole map, and
+     * writes roll over within their page if the device has pages. The registers are contiguous, so a read of any
+     * length is copied in one burst.
+     *
+     * With page writes, the device does not answer during its write cycle (the master polls it until it does).
+     *
+     * The simulation may access the registers from its own thread with setRegister() and the like. Subclasses
+     * may react to the bus with onRegisterWritten() and beforeRequest(), which are called with the registers
+     * locked (so they must use registers directly).
+     */
+    class I2CRegisterDevice : public I2CSlaveHandler {
+        private:
+            std::atomic_flag locked = ATOMIC_FLAG_INIT;
+
+            std::vector<RegisterAccess> access;
+            const size_t pointerBytes;
+            bool autoIncrement = true;
+
+            size_t pageSize = 0;
+            uint32_t writeCycleUs = 0;
+            std::shared_ptr<LabsLand::Utils::TimeManager> timeManager;
+            LabsLand::Utils::clock_t busyUntil = 0;
+
+            size_t nextToWrite(size_t address) const {
+                if (!autoIncrement)
+                    return address;
+                if (pageSize > 0)
+                    return address - address % pageSize + (address + 1) % pageSize;
+                return (address + 1) % registers.size();
+            }
+
+            void writeRegister(size_t address, unsigned char value) {
+                switch (access[address]) {
+                    case RegisterAccess::ReadWrite:
+                        registers[address] = value;
+                        break;
+                    case RegisterAccess::WriteOneToClear:
+                        registers[address] &= ~value;
+                        break;
+                    case RegisterAccess::ReadOnly:
+                        return;
+                }
+                onRegisterWritten(address, value);
+            }
+
+        protected:
+            std::vector<unsigned char> registers;
+            // Where the next read or write of the master starts
+            size_t pointer = 0;
+
+            /*
+             * The registers are shared by the thread of the bus and the one of the simulation. The critical
+             * sections are a few copies, so it is a spin lock (which also works without an OS).
+             */
+            class RegisterLock {
+                private:
+                    I2CRegisterDevice & device;
+
+                public:
+                    RegisterLock(I2CRegisterDevice & device): device(device) {
+                        while (device.locked.test_and_set(std::memory_order_acquire)) {}
+                    }
+
+                    ~RegisterLock() {
+                        device.locked.clear(std::memory_order_release);
+                    }
+
+                    RegisterLock(const RegisterLock &) = delete;
+                    RegisterLock & operator=(const RegisterLock &) = delete;
+            };
+
+            /*
+             * The master wrote value to a writable register (for W1C registers, value is what it wrote, not the result).
+             */
+            virtual void onRegisterWritten(size_t address, unsigned char value) {}
+
+            /*
+             * The master is about to read from the pointer (e.g., to sample inputs into the registers).
+             */
+            virtual void beforeRequest() {}
+
+        public:
+            I2CRegisterDevice(size_t size, size_t pointerBytes = 1, unsigned char initialValue = 0):
+                access(size, RegisterAccess::ReadWrite), pointerBytes(pointerBytes), registers(size, initialValue) {}
+
+            size_t getSize() const {
+                return this->registers.size();
+            }
+
+            void setAccess(size_t address, RegisterAccess registerAccess, size_t count = 1) {
+                for (size_t i = address; i < address + count && i < this->access.size(); i++)
+                    this->access[i] = registerAccess;
+            }
+
+            void setAutoIncrement(bool autoIncrement) {
+                this->autoIncrement = autoIncrement;
+            }
+
+            /*
+             * Writes wrap within pages of pageSize bytes, and every write transaction makes the device busy for
+             * writeCycleUs (measured with timeManager).
+             */
+            void setPageWrite(size_t pageSize, uint32_t writeCycleUs, std::shared_ptr<LabsLand::Utils::TimeManager> timeManager) {
+                this->pageSize = pageSize;
+                this->writeCycleUs = writeCycleUs;
+                this->timeManager = timeManager;
+            }
+
+            /*
+             * Access from the simulation, regardless of the access of the registers.
+             */
+            void setRegisters(size_t address, const unsigned char * data, size_t length) {
+                RegisterLock lock(*this);
+                if (address < this->registers.size())
+                    memcpy(this->registers.data() + address, data, std::min(length, this->registers.size() - address));
+            }
+
+            void getRegisters(size_t address, unsigned char * data, size_t length) {
+                RegisterLock lock(*this);
+                if (address < this->registers.size())
+                    memcpy(data, this->registers.data() + address, std::min(length, this->registers.size() - address));
+            }
+
+            void setRegister(size_t address, unsigned char value) {
+                this->setRegisters(address, &value, 1);
+            }
+
+            unsigned char getRegister(size_t address) {
+                unsigned char value = 0;
+                this->getRegisters(address, &value, 1);
+                return value;
+            }
+
+            virtual bool isReady() override {
+                return this->timeManager == nullptr || this->timeManager->getAbsoluteTime() >= this->busyUntil;
+            }
+
+            virtual void onReceive(const unsigned char * data, size_t length) override {
+                if (length < this->pointerBytes)
+                    return;
+
+                RegisterLock lock(*this);
+                if (this->pointerBytes > 0) {
+                    size_t newPointer = 0;
+                    for (size_t i = 0; i < this->pointerBytes; i++)
+                        newPointer = (newPointer << 8) | data[i];
+                    this->pointer = newPointer % this->registers.size();
+                }
+
+                // Only setting the pointer (e.g., before a read) is not a write
+                if (length == this->pointerBytes)
+                    return;
+
+                for (size_t i = this->pointerBytes; i < length; i++) {
+                    this->writeRegister(this->pointer, data[i]);
+                    this->pointer = this->nextToWrite(this->pointer);
+                }
+
+                if (this->writeCycleUs > 0 && this->timeManager != nullptr)
+                    this->busyUntil = this->timeManager->getAbsoluteTime() + (LabsLand::Utils::clock_t)this->writeCycleUs * this->timeManager->getClocksPerSec() / 1000000;
+            }
+
+            virtual size_t onRequest(unsigned char * data, size_t length) override {
+                RegisterLock lock(*this);
+                this->beforeRequest();
+
+                if (!this->autoIncrement) {
+                    memset(data, this->registers[this->pointer], length);
+                    return length;
+                }
+
+                size_t copied = 0;
+                while (copied < length) {
+                    size_t chunk = std::min(length - copied, this->registers.size() - this->pointer);
+                    memcpy(data + copied, this->registers.data() + this->pointer, chunk);
+                    copied += chunk;
+                    this->pointer = (this->pointer + chunk) % this->registers.size();
+                }
+                return length;
+            }
+    };
+}
+
+#endif
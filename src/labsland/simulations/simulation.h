@@ -9,20 +9,64 @@
 #define HYBRIDAPI_SIMULATION_H
 
 #include <iostream>
+#include <cmath>
+#include <cstring>
 #include <map>
 #include <vector>
 #include <memory>
 
 #include "../utils/timemanager.h"
+#include "../utils/timerwheel.h"
+#include "../utils/profiler.h"
 #include "utils/communicator.h"
+#include "utils/fields.h"
+#include "utils/queryargs.h"
+#include "utils/jsonwriter.h"
+#include "utils/reportratepolicy.h"
 #include "targetdevice.h"
 
 /**
  * Each output data type (from the simulation perspective) must have a serialize() method.
  * Also, it must be a struct and it must NOT contain dynamic memory (so no "string" but char buffer[], etc.).
+ *
+ * Data types may describe their fields (see utils/fields.h) and override serializeTo() and serializeBinary()
+ * with the generated serializers, so reports can be serialized without using the heap. Structured reports
+ * can be written with a JsonWriter (see utils/jsonwriter.h).
  */
 struct BaseOutputDataType {
     virtual std::string serialize() const = 0;
+
+    /**
+     * Serializes the same text as serialize() into the buffer. Returns the length of the serialized data,
+     * which will be greater than size if it did not fit (in which case the buffer contains only the beginning).
+     */
+    virtual size_t serializeTo(char * buffer, size_t size) const {
+        std::string serialized = serialize();
+        memcpy(buffer, serialized.data(), serialized.size() <= size ? serialized.size() : size);
+        return serialized.size();
+    }
+
+    /**
+     * Serializes the structure in a compact binary encoding into the buffer. Returns the length of the
+     * serialized data (greater than size if it did not fit), or 0 if the data type does not support it.
+     */
+    virtual size_t serializeBinary(char * buffer, size_t size) const {
+        return 0;
+    }
+
+    /**
+     * Builds the serialize() string out of serializeTo(), for data types that implement the latter.
+     */
+    std::string serializeToString() const {
+        char buffer[1024];
+        size_t length = serializeTo(buffer, sizeof(buffer));
+        if (length <= sizeof(buffer))
+            return std::string(buffer, length);
+
+        std::string serialized(length, '\0');
+        serializeTo(&serialized[0], length);
+        return serialized;
+    }
 };
 
 /**
@@ -43,45 +87,52 @@ struct BaseInputDataType {
      *    "foo&bar"          => {"foo": "1", "bar": "1"}
      *    "foo=1&bar=2"      => {"foo": "1", "bar", "2"}
      *    "foo=FOO&bar=baz"  => {"foo": "FOO", "bar": "baz"}
+     *
+     * For messages parsed often, prefer parseQueryArgs(input, args) with a QueryArgs (see
+     * utils/queryargs.h), which does not allocate.
      */
     std::map<std::string, std::string> parseQueryArgs(std::string const & input) {
         std::map<std::string, std::string> result;
+        LabsLand::Simulations::Utils::forEachQueryArg(input, [&result](std::string_view key, std::string_view value) {
+            result[std::string(key)] = std::string(value);
+        });
+        return result;
+    }
 
-        std::string currentVariable; // always things like "foo=bar"
-        std::string inputRemainder(input);
-
-        while(inputRemainder.size() > 0) {
-            size_t posAnd = inputRemainder.find('&');
-            if (posAnd == std::string::npos) {
-                currentVariable = inputRemainder;                    
-                inputRemainder = "";
-            } else {
-                currentVariable = inputRemainder.substr(0, posAnd);
-                inputRemainder.erase(0, posAnd + 1);
-            }
-
-            size_t posEquals = currentVariable.find('=');
-            if (posEquals == std::string::npos) {
-                // foo&bar means that foo=1 and bar=1
-                result[currentVariable] = "1";
-            } else {
-                result[currentVariable.substr(0, posEquals)] = currentVariable.substr(posEquals+1, currentVariable.size());
-            }
-        };
+    /*
+     * Same as the previous function, but storing the variables in a fixed-capacity array that
+     * points to input. Returns false if there were more variables than the capacity.
+     */
+    template <size_t Capacity>
+    bool parseQueryArgs(std::string_view input, LabsLand::Simulations::Utils::QueryArgs<Capacity> & args) {
+        return args.parse(input);
+    }
 
-        return result;
+    template <size_t Capacity, size_t N>
+    bool parseQueryArgs(std::string_view input, LabsLand::Simulations::Utils::QueryArgs<Capacity> & args,
+                        LabsLand::Simulations::Utils::QueryVariables<N> const & knownVariables) {
+        return args.parse(input, knownVariables);
     }
 
     /*
      * Given a map like the one explained in the previous function, return if all the required variables
      * are present or not.
      */
-    bool checkVariablesInArgs(std::map<std::string, std::string> const & args, std::vector<std::string> const requiredVariables) {
-        for (std::string requiredVariable : requiredVariables)
+    bool checkVariablesInArgs(std::map<std::string, std::string> const & args, std::vector<std::string> const & requiredVariables) {
+        for (std::string const & requiredVariable : requiredVariables)
             if (args.count(requiredVariable) == 0)
                 return false;
         return true;
     }
+
+    /*
+     * Same, with args parsed with known variables and the mask of the required ones
+     * (see QueryVariables::maskOf).
+     */
+    template <size_t Capacity>
+    bool checkVariablesInArgs(LabsLand::Simulations::Utils::QueryArgs<Capacity> const & args, uint64_t requiredVariables) {
+        return args.hasAll(requiredVariables);
+    }
 };
 
 
@@ -101,9 +152,38 @@ class Simulation
         // is reported continuously. When it is enabled, it can be marked through the requestReportState() API.
         bool mReportWhenMarked = false;
 
+        // Optional strategy that adapts mVirtualEnvironmentReportPeriod after each report cycle. If there is
+        // none, the period only changes through setVirtualEnvironmentReportPeriod().
+        std::shared_ptr<LabsLand::Simulations::Utils::ReportRatePolicy> mReportRatePolicy = nullptr;
+        uint64_t mLastReportSequence = 0;
+        uint64_t mLastReportAcknowledgements = 0;
+        bool mReportedInCycle = false;
+
         LabsLand::Utils::clock_t mLastUpdate;
         LabsLand::Utils::clock_t mLastReportUpdate;
 
+        // Fixed-timestep mode (disabled if mFixedTimestep is 0): step() is called with mFixedTimestep seconds
+        // as many times as fit in the elapsed time, up to mMaxCatchUpSteps per _update(). Time that does not
+        // fit in a step is kept in mStepAccumulator for the next _update(); time beyond the catch-up cap is dropped.
+        double mFixedTimestep = 0;
+        uint32_t mMaxCatchUpSteps = 0;
+        double mStepAccumulator = 0;
+        double mDroppedStepTime = 0;
+
+        // Event-driven simulations only need update() when an input changes, a request arrives or one of the
+        // wakeups they scheduled (kept in mWakeups, with a resolution of 1 ms) expires. See setEventDriven().
+        bool mEventDriven = false;
+        LabsLand::Utils::TimerWheel mWakeups;
+        bool mReadRequestInUpdate = false;
+
+        // If enabled, requests are read by the Simulation and passed to onRequest() (see setDispatchRequests())
+        bool mDispatchRequests = false;
+
+#ifdef LL_PROFILING
+        // Time spent in each phase of the ticks (see getProfiler())
+        LabsLand::Utils::Profiler mProfiler;
+#endif
+
     protected:
 
         std::shared_ptr<LabsLand::Utils::TimeManager> timeManager = nullptr;
@@ -116,19 +196,39 @@ class Simulation
          * then the function returns true and will have copied the data to the structure. Otherwise it will return false
          * and copy nothing. Retrieved items are removed from the queue and never returned again.
          *
-         * If your simulation does sleeps and the user interface sends many requests fast, some requests might be lost.
+         * Requests are returned in order, one per call. With communicators that do not queue requests, if your
+         * simulation does sleeps and the user interface sends many requests fast, some requests might be lost.
          *
          * For this reason, design your simulation to send the full state in each request instead of only diffs.
          *
          * @return if a request has been read.
          */
         bool readRequest(InputDataType &request) {
+            LL_PROFILE_SCOPE(&mProfiler, Requests);
             if (auto comm = this->communicator.lock()) {
-                return comm->readRequest(request);
+                bool requestWasRead = comm->readRequest(request);
+                mReadRequestInUpdate |= requestWasRead;
+                return requestWasRead;
             }
             return false;
         }
 
+        /**
+         * Retrieves up to maxRequests pending requests at once (e.g., to handle all of them in a single update()),
+         * in the order in which they were sent.
+         *
+         * @return the number of requests copied into the array.
+         */
+        size_t readRequests(InputDataType * requests, size_t maxRequests) {
+            LL_PROFILE_SCOPE(&mProfiler, Requests);
+            if (auto comm = this->communicator.lock()) {
+                size_t count = comm->readRequests(requests, maxRequests);
+                mReadRequestInUpdate |= count > 0;
+                return count;
+            }
+            return 0;
+        }
+
         /**
          * Enables and disables the report when marked mode.
          * @param reportWhenMarked
@@ -167,8 +267,107 @@ class Simulation
          * perspective.
          */
         void sendVirtualEnvironmentReport() {
-            if (auto comm = this->communicator.lock())
+            if (auto comm = this->communicator.lock()) {
+                LL_PROFILE_SCOPE(&mProfiler, CommunicatorIO);
                 comm->sendReport(mState);
+                mReportedInCycle = true;
+            }
+        }
+
+        /**
+         * Sets the strategy that decides the virtual environment report period after each report cycle
+         * (e.g., an AdaptiveReportRatePolicy). Pass nullptr to keep the period fixed.
+         */
+        void setReportRatePolicy(std::shared_ptr<LabsLand::Simulations::Utils::ReportRatePolicy> policy) {
+            mReportRatePolicy = policy;
+        }
+
+        /**
+         * Asks the report rate policy (if any) for the period until the next report cycle.
+         */
+        void updateReportPeriod() {
+            if (mReportRatePolicy == nullptr)
+                return;
+
+            LabsLand::Simulations::Utils::ReportRateFeedback feedback = {};
+            feedback.reported = mReportedInCycle;
+            feedback.changed = mReportedInCycle;
+            if (auto comm = this->communicator.lock()) {
+                uint64_t sequence = comm->getReportSequence();
+                if (sequence != 0 || mLastReportSequence != 0)
+                    feedback.changed = sequence != mLastReportSequence;
+                mLastReportSequence = sequence;
+
+                feedback.acknowledgementsSupported = comm->supportsReportAcknowledgements();
+                if (feedback.acknowledgementsSupported) {
+                    uint64_t acknowledgements = comm->getReportAcknowledgements();
+                    feedback.acknowledged = acknowledgements != mLastReportAcknowledgements;
+                    mLastReportAcknowledgements = acknowledgements;
+                }
+            }
+            mReportedInCycle = false;
+
+            mVirtualEnvironmentReportPeriod = mReportRatePolicy->nextPeriod(mVirtualEnvironmentReportPeriod, feedback);
+        }
+
+        /**
+         * Enables the fixed-timestep mode: in each _update(), before update(), step() is called with exactly
+         * timestep seconds as many times as the elapsed time allows, so the physics of the simulation is stable
+         * and deterministic regardless of how often _update() is called. After a stall, at most maxCatchUpSteps
+         * steps are run and the rest of the elapsed time is dropped (the simulation falls behind instead of
+         * integrating a long interval at once). Pass 0 to disable it.
+         */
+        void setFixedTimestep(double timestep, uint32_t maxCatchUpSteps = 10) {
+            mFixedTimestep = timestep;
+            mMaxCatchUpSteps = maxCatchUpSteps;
+            mStepAccumulator = 0;
+        }
+
+        double getFixedTimestep() {
+            return mFixedTimestep;
+        }
+
+        /**
+         * Simulated time (in seconds) dropped so far because of the catch-up cap of the fixed-timestep mode.
+         */
+        double getDroppedStepTime() {
+            return mDroppedStepTime;
+        }
+
+        /**
+         * Declares that the simulation only needs update() to be called when something happens: an input of the
+         * target device changes, a request arrives from the user interface or a wakeup scheduled with
+         * scheduleWakeup() expires. Runners supporting it (the "event" mode) then block in between instead of
+         * calling update() periodically. Event-driven simulations must read the pending requests in update(), and
+         * handle a long delta: it covers all the time since the previous update, however long it was idle.
+         */
+        void setEventDriven(bool eventDriven) {
+            mEventDriven = eventDriven;
+        }
+
+        /**
+         * Enables the request dispatch: pending requests are read by the Simulation and passed to onRequest()
+         * one by one, before update() and, with runners that support it, as soon as they arrive (without waiting
+         * for the next update). readRequest() then finds no requests in update().
+         */
+        void setDispatchRequests(bool dispatchRequests) {
+            mDispatchRequests = dispatchRequests;
+        }
+
+        /**
+         * Schedules a call to onWakeup(tag) (followed by update()) in the given number of seconds, for example to
+         * keep evolving the state while it is not stable. It can be cancelled with cancelWakeup().
+         */
+        LabsLand::Utils::TimerWheel::TimerId scheduleWakeup(double seconds, uint32_t tag = 0) {
+            LabsLand::Utils::clock_t delay = (LabsLand::Utils::clock_t)(seconds * this->timeManager->getClocksPerSec());
+            return mWakeups.schedule(this->timeManager->getAbsoluteTime() + delay, tag);
+        }
+
+        /**
+         * Cancels a wakeup. Returns false if it already expired (or was cancelled).
+         */
+        bool cancelWakeup(LabsLand::Utils::TimerWheel::TimerId wakeup) {
+            return mWakeups.cancel(wakeup);
         }
 
         /**
@@ -208,6 +407,10 @@ class Simulation
          */
         void injectCommunicator(std::weak_ptr<LabsLand::Simulations::Utils::SimulationCommunicator<OutputDataType, InputDataType>> communicator) {
             this->communicator = communicator;
+#ifdef LL_PROFILING
+            if (auto comm = communicator.lock())
+                comm->setProfiler(&mProfiler);
+#endif
         }
 
         /**
@@ -215,6 +418,9 @@ class Simulation
          */
         void injectTargetDevice(std::shared_ptr<LabsLand::Utils::TargetDevice> targetDevice) {
             this->targetDevice = targetDevice;
+#ifdef LL_PROFILING
+            targetDevice->setProfiler(&mProfiler);
+#endif
         }
 
         /*
@@ -245,18 +451,133 @@ class Simulation
          * @param clk Current clock()
          */
         void _update(LabsLand::Utils::clock_t currentClock) {
+            LL_PROFILE_SCOPE(&mProfiler, Tick);
             LabsLand::Utils::clock_t elapsedUpdate = currentClock - mLastUpdate;
-            LabsLand::Utils::clock_t elapsedReportUpdate = currentClock - mLastReportUpdate;
 
-            update(elapsedUpdate / (double)this->timeManager->getClocksPerSec());
+            mReadRequestInUpdate = false;
+            _dispatchRequests();
+            mWakeups.advance(currentClock, [this](LabsLand::Utils::TimerWheel::TimerId wakeup, uint32_t tag) {
+                onWakeup(tag);
+            });
+
+            double delta = elapsedUpdate / (double)this->timeManager->getClocksPerSec();
+            {
+                LL_PROFILE_SCOPE(&mProfiler, Update);
+                if (mFixedTimestep > 0)
+                    runFixedSteps(delta);
+
+                update(delta);
+            }
             mLastUpdate = currentClock;
 
+            _updateReport(currentClock);
+        }
+
+        /**
+         * Internal method: the report part of _update(), which runs reportUpdate() if the report period elapsed.
+         * Event-driven runners call it alone when they only wake up to report (see getNextWakeup()).
+         */
+        void _updateReport(LabsLand::Utils::clock_t currentClock) {
+            LabsLand::Utils::clock_t elapsedReportUpdate = currentClock - mLastReportUpdate;
             if(elapsedReportUpdate / (double)this->timeManager->getClocksPerSec() > mVirtualEnvironmentReportPeriod) {
+                LL_PROFILE_SCOPE(&mProfiler, Report);
                 reportUpdate();
+                updateReportPeriod();
                 mLastReportUpdate = currentClock;
             }
         }
 
+        /**
+         * Internal method: if the request dispatch is enabled, passes the pending requests to onRequest(). If any
+         * of them marked the state to be reported (see requestReportState()), it is reported straight away instead
+         * of in the next report cycle, so the user interface sees the effect of the request as soon as possible.
+         *
+         * @return the number of requests dispatched.
+         */
+        size_t _dispatchRequests() {
+            if (!mDispatchRequests)
+                return 0;
+
+            auto comm = this->communicator.lock();
+            if (!comm)
+                return 0;
+
+            size_t count = 0;
+            {
+                LL_PROFILE_SCOPE(&mProfiler, Requests);
+                InputDataType request;
+                while (comm->readRequest(request)) {
+                    onRequest(request);
+                    count++;
+                }
+            }
+
+            if (count > 0 && mReportWhenMarked && mShouldReportInReportWhenMarkedMode) {
+                LL_PROFILE_SCOPE(&mProfiler, Report);
+                reportUpdate();
+                mLastReportUpdate = this->timeManager->getAbsoluteTime();
+            }
+            return count;
+        }
+
+#ifdef LL_PROFILING
+        LabsLand::Utils::Profiler & getProfiler() {
+            return mProfiler;
+        }
+#endif
+
+        bool dispatchesRequests() {
+            return mDispatchRequests;
+        }
+
+        bool isEventDriven() {
+            return mEventDriven;
+        }
+
+        /**
+         * For event-driven runners: the time of the next scheduled wakeup, or NEVER if there is none.
+         */
+        LabsLand::Utils::clock_t getNextWakeup() {
+            return mWakeups.getNextExpiry();
+        }
+
+        /**
+         * For event-driven runners: the time at which the next report cycle is due if there is something to
+         * report (a state marked with requestReportState(), or always if not in the report-when-marked mode),
+         * or NEVER otherwise.
+         */
+        LabsLand::Utils::clock_t getNextReport() {
+            if (mReportWhenMarked && !mShouldReportInReportWhenMarkedMode)
+                return LabsLand::Utils::TimerWheel::NEVER;
+            return mLastReportUpdate + (LabsLand::Utils::clock_t)std::ceil(mVirtualEnvironmentReportPeriod * this->timeManager->getClocksPerSec()) + 1;
+        }
+
+        /**
+         * Whether update() read any request in the last _update() (so there might be more pending).
+         */
+        bool readRequestInLastUpdate() {
+            return mReadRequestInUpdate;
+        }
+
+        /**
+         * Internal method: calls step() for the elapsed time in the fixed-timestep mode.
+         */
+        void runFixedSteps(double delta) {
+            mStepAccumulator += delta;
+            uint32_t steps = 0;
+            while (mStepAccumulator >= mFixedTimestep && steps < mMaxCatchUpSteps) {
+                step(mFixedTimestep);
+                mStepAccumulator -= mFixedTimestep;
+                steps++;
+            }
+
+            if (mStepAccumulator >= mFixedTimestep) {
+                double dropped = mStepAccumulator - std::fmod(mStepAccumulator, mFixedTimestep);
+                mDroppedStepTime += dropped;
+                mStepAccumulator -= dropped;
+            }
+        }
+
         /**
          * Internal method to be invoked to initialize the simulation. It will conduct some initial housekeeping and
          * then invoke the virtual initialize() function that simulation developers are meant to override.
@@ -264,6 +585,8 @@ class Simulation
         void _initialize() {
             mLastUpdate = this->timeManager->getAbsoluteTime();
             mLastReportUpdate = this->timeManager->getAbsoluteTime();
+            // Wakeups with a resolution of 1 ms
+            mWakeups.reset(this->timeManager->getClocksPerSec() / 1000, mLastUpdate);
 
             initialize();
         }
@@ -279,6 +602,29 @@ class Simulation
         virtual void update(double delta) {
         }
 
+        /**
+         * Only in the fixed-timestep mode (see setFixedTimestep()): invoked before update() zero or more times, each
+         * time with the same dt (in seconds). Override it to integrate the physics of the simulation, and leave the
+         * interaction with the target device and the user interface to update().
+         *
+         * @param dt The fixed timestep, in seconds.
+         */
+        virtual void step(double dt) {
+        }
+
+        /**
+         * Only with the request dispatch enabled (see setDispatchRequests()): invoked for each request received from
+         * the user interface, in order, as soon as possible after it arrives.
+         */
+        virtual void onRequest(const InputDataType & request) {
+        }
+
+        /**
+         * Invoked before update() for each wakeup scheduled with scheduleWakeup() that expired, with its tag.
+         */
+        virtual void onWakeup(uint32_t tag) {
+        }
+
         /**
          * Invoked periodically by the system to send the simulation's state to the environment/external system. The frequecy
          * at which this is run should be the mVirtualEnvironmentReportPeriod. If in reportWhenMarked mode, then it will only
@@ -318,10 +664,21 @@ class Simulation
         }
 
         /*
-         * Get an ostream to log to
+         * Get an ostream to log to (with the Info level)
          */
         virtual std::ostream& log() {
-            return this->targetDevice->log();
+            return this->targetDevice->log(LabsLand::Utils::LogLevel::Info);
+        }
+
+        /*
+         * Get an ostream to log messages of a level to (see LL_LOG() in utils/logging.h)
+         */
+        std::ostream& log(LabsLand::Utils::LogLevel level) {
+            return this->targetDevice->log(level);
+        }
+
+        bool isLogEnabled(LabsLand::Utils::LogLevel level) const {
+            return this->targetDevice->isLogEnabled(level);
         }
 
         /**
@@ -102,6 +102,36 @@ I2CSlaveConfiguration * TargetDeviceConfiguration::getSecondI2CSlaveConfig() con
     return this->secondI2CSlaveConfig;
 }
 
+void TargetDeviceConfiguration::setI2CRouter(I2CRouter * i2cRouter) {
+    if (this->i2cRouter != nullptr) {
+        delete this->i2cRouter;
+        this->i2cRouter = nullptr;
+    }
+
+    this->i2cRouter = i2cRouter;
+}
+
+I2CRouter * TargetDeviceConfiguration::getI2CRouter() const {
+    return this->i2cRouter;
+}
+
+void TargetDeviceConfiguration::setSPISlaveConfig(SPISlaveConfiguration * spiSlaveConfig) {
+    if (this->spiSlaveConfig != nullptr) {
+        delete this->spiSlaveConfig;
+        this->spiSlaveConfig = nullptr;
+    }
+
+    this->spiSlaveConfig = spiSlaveConfig;
+}
+
+void TargetDeviceConfiguration::setSPISlaveConfig(spiSlaveCallback * callback, unsigned int chipSelectPin) {
+    setSPISlaveConfig(new SPISlaveConfiguration(callback, chipSelectPin));
+}
+
+SPISlaveConfiguration * TargetDeviceConfiguration::getSPISlaveConfig() const {
+    return this->spiSlaveConfig;
+}
+
 TargetDeviceConfiguration::~TargetDeviceConfiguration() {
     if (this->firstI2CSlaveConfig != nullptr) {
         delete this->firstI2CSlaveConfig;
@@ -111,6 +141,14 @@ TargetDeviceConfiguration::~TargetDeviceConfiguration() {
         delete this->secondI2CSlaveConfig;
         this->secondI2CSlaveConfig = nullptr;
     }
+    if (this->i2cRouter != nullptr) {
+        delete this->i2cRouter;
+        this->i2cRouter = nullptr;
+    }
+    if (this->spiSlaveConfig != nullptr) {
+        delete this->spiSlaveConfig;
+        this->spiSlaveConfig = nullptr;
+    }
 }
 
 /*
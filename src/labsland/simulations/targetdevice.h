@@ -14,6 +14,8 @@
 #include <memory>
 
 #include "labsland/protocols.h"
+#include "../utils/logging.h"
+#include "../utils/profiler.h"
 
 namespace LabsLand::Utils {
 
@@ -70,6 +72,12 @@ namespace LabsLand::Utils {
         protected:
             // Note: the destructor of the target device will destroy this
             std::unique_ptr<TargetDeviceConfiguration> configuration = nullptr;
+            // Messages below this level are discarded (see log(LogLevel))
+            LogLevel logLevel = LogLevel::Info;
+#ifdef LL_PROFILING
+            // Where the implementation records its I/O (set by Simulation::injectTargetDevice())
+            Profiler * profiler = nullptr;
+#endif
         public:
             virtual ~TargetDevice();
             /*
@@ -148,12 +156,55 @@ namespace LabsLand::Utils {
              */
             virtual std::ostream& log() = 0;
 
+            /*
+             * The log, if messages of that level are enabled, or a stream that discards them
+             * otherwise. Use LL_LOG(level) to avoid formatting the discarded messages.
+             */
+            std::ostream& log(LogLevel level) {
+                return this->isLogEnabled(level) ? this->log() : nullLogStream();
+            }
+
+            bool isLogEnabled(LogLevel level) const {
+                return level >= this->logLevel;
+            }
+
+            void setLogLevel(LogLevel level) {
+                this->logLevel = level;
+            }
+
+            LogLevel getLogLevel() const {
+                return this->logLevel;
+            }
+
+#ifdef LL_PROFILING
+            void setProfiler(Profiler * profiler) {
+                this->profiler = profiler;
+            }
+#endif
+
             /**
              * Same, but using custom names
              */
             virtual void setGpio(LabsLand::Protocols::NamedGpio outputPosition, bool value = true) = 0;
             virtual void resetGpio(LabsLand::Protocols::NamedGpio outputPosition) = 0;
             virtual bool getGpio(LabsLand::Protocols::NamedGpio inputPosition) = 0;
+
+            /*
+             * File descriptor that becomes readable when the inputs might have changed (e.g., an
+             * inotify watch of the input files), so event-driven loops can block until then.
+             * Returns -1 if the target device cannot notify changes (the inputs must be polled).
+             */
+            virtual int getInputEventFd() {
+                return -1;
+            }
+
+            /*
+             * Consumes the notifications of getInputEventFd(). Returns whether the inputs might have
+             * changed since the last call (always true if the target device cannot notify changes).
+             */
+            virtual bool consumeInputEvents() {
+                return true;
+            }
     };
 
     class TargetDeviceConfiguration {
@@ -167,6 +218,12 @@ namespace LabsLand::Utils {
             LabsLand::Protocols::I2CSlaveConfiguration * firstI2CSlaveConfig = nullptr; // Destroyed by this class
             LabsLand::Protocols::I2CSlaveConfiguration * secondI2CSlaveConfig = nullptr; // Destroyed by this class
 
+            // or any number of them on the first channel, with a router (not both)
+            LabsLand::Protocols::I2CRouter * i2cRouter = nullptr; // Destroyed by this class
+
+            // and one SPI slave
+            LabsLand::Protocols::SPISlaveConfiguration * spiSlaveConfig = nullptr; // Destroyed by this class
+
         public:
             TargetDeviceConfiguration(int outputGpios = 0, int inputGpios = 0, LabsLand::Protocols::I2CSlaveConfiguration * firstI2CSlaveConfig = nullptr, LabsLand::Protocols::I2CSlaveConfiguration * secondI2CSlaveConfig = nullptr);
             TargetDeviceConfiguration(std::vector<std::string> outputGpios, std::vector<std::string> inputGpios, LabsLand::Protocols::I2CSlaveConfiguration * firstI2CSlaveConfig = nullptr, LabsLand::Protocols::I2CSlaveConfiguration * secondI2CSlaveConfig = nullptr);
@@ -192,6 +249,19 @@ namespace LabsLand::Utils {
 
             LabsLand::Protocols::I2CSlaveConfiguration * getSecondI2CSlaveConfig() const;
 
+            /*
+             * The slaves are added to the router by the simulation (which keeps them).
+             */
+            void setI2CRouter(LabsLand::Protocols::I2CRouter * i2cRouter);
+
+            LabsLand::Protocols::I2CRouter * getI2CRouter() const;
+
+            void setSPISlaveConfig(LabsLand::Protocols::SPISlaveConfiguration * spiSlaveConfig);
+
+            void setSPISlaveConfig(LabsLand::Protocols::spiSlaveCallback * callback, unsigned int chipSelectPin);
+
+            LabsLand::Protocols::SPISlaveConfiguration * getSPISlaveConfig() const;
+
             ~TargetDeviceConfiguration();
     };
 
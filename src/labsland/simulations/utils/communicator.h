@@ -8,6 +8,11 @@
 #ifndef SIMULATION_COMMUNICATIONS_H
 #define SIMULATION_COMMUNICATIONS_H
 
+#include <cstddef>
+#include <cstdint>
+
+#include "../../utils/profiler.h"
+
 namespace LabsLand::Simulations::Utils {
 
     template <class OutputDataType, class InputDataType>
@@ -17,14 +22,26 @@ namespace LabsLand::Simulations::Utils {
             /*
              * Receive data from the user interface (web browser). Override
              * request only if data is provided (in which case, return true).
-             * 
-             * IMPORTANT: internally, if the user interface sends information
-             * very fast and your simulation makes long sleeps, you might miss
-             * information as the requests can be overriden by newer requests.
-             * Ideally, send always the full state (instead of only the diffs),
-             * and do not use sleep too much.
+             *
+             * Requests are returned in the order in which they were sent, one
+             * per call. Some implementations might not queue requests, in which
+             * case if the user interface sends information very fast and your
+             * simulation makes long sleeps, newer requests might override older
+             * ones. Ideally, send always the full state (instead of only the
+             * diffs), and do not use sleep too much.
              */
              virtual bool readRequest(InputDataType & request) = 0;
+
+            /*
+             * Receive up to maxRequests pending requests at once, in order.
+             * Returns the number of requests copied into the array.
+             */
+             virtual size_t readRequests(InputDataType * requests, size_t maxRequests) {
+                 size_t count = 0;
+                 while (count < maxRequests && readRequest(requests[count]))
+                     count++;
+                 return count;
+             }
          
             /**
              * Update latest data so, when the user interface (web browser)
@@ -37,6 +54,59 @@ namespace LabsLand::Simulations::Utils {
              * read. So store the full state (instead of diffs).
              */
              virtual void sendReport(OutputDataType & report) = 0;
+
+            /*
+             * Number of reports published so far. Reports identical to the previous one
+             * are not published, so this only grows when the state changes. Returns 0 if
+             * the implementation does not keep track of it.
+             */
+             virtual uint64_t getReportSequence() const {
+                 return 0;
+             }
+
+            /*
+             * Counter bumped by the user interface (web server) each time it reads a report,
+             * so the simulation can tell whether anybody is reading them (see ReportRatePolicy).
+             * Only meaningful if supportsReportAcknowledgements().
+             */
+             virtual uint64_t getReportAcknowledgements() {
+                 return 0;
+             }
+
+             virtual bool supportsReportAcknowledgements() const {
+                 return false;
+             }
+
+            /*
+             * File descriptor that becomes readable when new requests might be available
+             * (e.g., a socket or an inotify watch of the input file), so event-driven loops
+             * can block until then. Returns -1 if the implementation cannot notify requests
+             * (they must be polled).
+             */
+             virtual int getRequestEventFd() {
+                 return -1;
+             }
+
+            /*
+             * Consumes the notifications of getRequestEventFd(). Returns whether new requests
+             * might be available (always true if the implementation cannot notify requests).
+             */
+             virtual bool consumeRequestEvents() {
+                 return true;
+             }
+
+#ifdef LL_PROFILING
+            /*
+             * Where the implementation records the serialization of the reports, if it is done in
+             * the thread that updates the simulation (set by Simulation::injectCommunicator()).
+             */
+            void setProfiler(LabsLand::Utils::Profiler * profiler) {
+                this->profiler = profiler;
+            }
+
+        protected:
+            LabsLand::Utils::Profiler * profiler = nullptr;
+#endif
     };
 
 }
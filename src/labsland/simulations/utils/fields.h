@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef SIMULATION_FIELDS_H
+#define SIMULATION_FIELDS_H
+
+#include <tuple>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <cctype>
+#include <type_traits>
+
+/*
+ * Compile-time field descriptors for the output and input data types of the simulations.
+ *
+ * A data type declares its fields once, in order, next to its members:
+ *
+ *     struct DoorData : public BaseOutputDataType {
+ *         bool open;
+ *         bool close;
+ *
+ *         static constexpr auto fields() {
+ *             return describeFields(field("open", &DoorData::open), field("close", &DoorData::close));
+ *         }
+ *     };
+ *
+ * and the functions below generate the serialization from them, writing into a buffer
+ * provided by the caller (no heap is used):
+ *
+ *  - writeValueList:  "<value>&<value>&...&" (each value followed by '&')
+ *  - writeQueryArgs:  "<name>=<value>&<name>=<value>" (array elements as "<name><index>=<value>")
+ *  - writeBinary:     the raw bytes of each field in order (bool as 1 byte), with no padding
+ *  - readValueList / readBinary: the opposite operations
+ *
+ * Supported field types: bool, char, integers, float, double and fixed-size arrays of them.
+ * Text values are formatted like a default std::ostream would (floats as "%g", bools as 0/1).
+ */
+namespace LabsLand::Simulations::Utils {
+
+    template <class Struct, class Member>
+    struct FieldDescriptor {
+        const char * name;
+        Member Struct::* member;
+    };
+
+    template <class Struct, class Member>
+    constexpr FieldDescriptor<Struct, Member> field(const char * name, Member Struct::* member) {
+        return { name, member };
+    }
+
+    template <class... Fields>
+    constexpr std::tuple<Fields...> describeFields(Fields... fields) {
+        return std::tuple<Fields...>(fields...);
+    }
+
+    /*
+     * Appends to a fixed buffer. Once the buffer is full, it keeps counting the characters
+     * that would have been written (like snprintf), so the caller can tell the required size.
+     */
+    class FixedBufferWriter {
+        private:
+            char * buffer;
+            size_t size;
+            size_t length = 0;
+
+        public:
+            FixedBufferWriter(char * buffer, size_t size): buffer(buffer), size(size) {}
+
+            void append(char c) {
+                if (length < size)
+                    buffer[length] = c;
+                length++;
+            }
+
+            void append(const char * data, size_t dataLength) {
+                if (length < size)
+                    memcpy(buffer + length, data, dataLength <= size - length ? dataLength : size - length);
+                length += dataLength;
+            }
+
+            void append(const char * text) {
+                append(text, strlen(text));
+            }
+
+            /*
+             * Number of characters written (or that would have been written if the buffer was big enough).
+             */
+            size_t getLength() const {
+                return length;
+            }
+
+            bool overflowed() const {
+                return length > size;
+            }
+    };
+
+    namespace Fields {
+
+        template <class T>
+        struct ElementType {
+            typedef T type;
+            static constexpr size_t count = 1;
+        };
+
+        template <class T, size_t N>
+        struct ElementType<T[N]> {
+            typedef T type;
+            static constexpr size_t count = N;
+        };
+
+        template <class T>
+        const typename ElementType<T>::type * elements(const T & value) {
+            if constexpr (std::is_array<T>::value)
+                return value;
+            else
+                return &value;
+        }
+
+        template <class T>
+        typename ElementType<T>::type * elements(T & value) {
+            if constexpr (std::is_array<T>::value)
+                return value;
+            else
+                return &value;
+        }
+
+        template <class T>
+        void writeText(FixedBufferWriter & writer, T value) {
+            static_assert(std::is_arithmetic<T>::value, "Unsupported field type");
+            char text[32];
+            int textLength;
+            if constexpr (std::is_same<T, bool>::value) {
+                writer.append(value ? '1' : '0');
+                return;
+            } else if constexpr (std::is_same<T, char>::value) {
+                writer.append(value);
+                return;
+            } else if constexpr (std::is_floating_point<T>::value) {
+                textLength = snprintf(text, sizeof(text), "%g", (double)value);
+            } else if constexpr (std::is_signed<T>::value) {
+                textLength = snprintf(text, sizeof(text), "%lld", (long long)value);
+            } else {
+                textLength = snprintf(text, sizeof(text), "%llu", (unsigned long long)value);
+            }
+            writer.append(text, textLength);
+        }
+
+        /*
+         * Parses a text value (the whole [begin, end) range). Decimal commas are accepted.
+         */
+        template <class T>
+        bool readText(const char * begin, const char * end, T & value) {
+            static_assert(std::is_arithmetic<T>::value, "Unsupported field type");
+            char text[32];
+            size_t textLength = end - begin;
+            if (textLength == 0 || textLength >= sizeof(text))
+                return false;
+
+            if constexpr (std::is_same<T, char>::value) {
+                if (textLength != 1)
+                    return false;
+                value = *begin;
+                return true;
+            }
+
+            for (size_t i = 0; i < textLength; i++)
+                text[i] = begin[i] == ',' ? '.' : begin[i];
+            text[textLength] = '\0';
+
+            char * parsedEnd = nullptr;
+            if constexpr (std::is_floating_point<T>::value) {
+                value = (T)strtod(text, &parsedEnd);
+            } else if constexpr (std::is_same<T, bool>::value) {
+                value = strtoll(text, &parsedEnd, 10) != 0;
+            } else if constexpr (std::is_signed<T>::value) {
+                value = (T)strtoll(text, &parsedEnd, 10);
+            } else {
+                value = (T)strtoull(text, &parsedEnd, 10);
+            }
+            return parsedEnd == text + textLength;
+        }
+
+        template <class Struct, class Function>
+        constexpr void forEachField(Function function) {
+            std::apply([&function](auto... descriptors) { (function(descriptors), ...); }, Struct::fields());
+        }
+    }
+
+    /*
+     * "<value>&<value>&...&": every value (or array element) followed by '&'.
+     * Returns the length of the serialized data (which might be greater than size if it did not fit).
+     */
+    template <class Struct>
+    size_t writeValueList(const Struct & data, char * buffer, size_t size) {
+        FixedBufferWriter writer(buffer, size);
+        Fields::forEachField<Struct>([&](auto descriptor) {
+            const auto & value = data.*(descriptor.member);
+            typedef std::remove_cv_t<std::remove_reference_t<decltype(value)>> MemberType;
+            const auto * items = Fields::elements(value);
+            for (size_t i = 0; i < Fields::ElementType<MemberType>::count; i++) {
+                Fields::writeText(writer, items[i]);
+                writer.append('&');
+            }
+        });
+        return writer.getLength();
+    }
+
+    /*
+     * "<name>=<value>&<name>=<value>": array elements are written as "<name><index>=<value>".
+     * Returns the length of the serialized data (which might be greater than size if it did not fit).
+     */
+    template <class Struct>
+    size_t writeQueryArgs(const Struct & data, char * buffer, size_t size) {
+        FixedBufferWriter writer(buffer, size);
+        bool first = true;
+        Fields::forEachField<Struct>([&](auto descriptor) {
+            const auto & value = data.*(descriptor.member);
+            typedef std::remove_cv_t<std::remove_reference_t<decltype(value)>> MemberType;
+            const auto * items = Fields::elements(value);
+            for (size_t i = 0; i < Fields::ElementType<MemberType>::count; i++) {
+                if (!first)
+                    writer.append('&');
+                first = false;
+                writer.append(descriptor.name);
+                if (std::is_array<MemberType>::value)
+                    Fields::writeText(writer, i);
+                writer.append('=');
+                Fields::writeText(writer, items[i]);
+            }
+        });
+        return writer.getLength();
+    }
+
+    /*
+     * Raw bytes of every field, in order and without padding (bools as a single 0/1 byte).
+     * Returns the length of the serialized data (which might be greater than size if it did not fit).
+     */
+    template <class Struct>
+    size_t writeBinary(const Struct & data, char * buffer, size_t size) {
+        FixedBufferWriter writer(buffer, size);
+        Fields::forEachField<Struct>([&](auto descriptor) {
+            const auto & value = data.*(descriptor.member);
+            typedef std::remove_cv_t<std::remove_reference_t<decltype(value)>> MemberType;
+            typedef typename Fields::ElementType<MemberType>::type ItemType;
+            const ItemType * items = Fields::elements(value);
+            if constexpr (std::is_same<ItemType, bool>::value) {
+                for (size_t i = 0; i < Fields::ElementType<MemberType>::count; i++)
+                    writer.append((char)(items[i] ? 1 : 0));
+            } else {
+                writer.append((const char *)items, sizeof(MemberType));
+            }
+        });
+        return writer.getLength();
+    }
+
+    /*
+     * Size of the binary encoding of Struct.
+     */
+    template <class Struct>
+    constexpr size_t binarySize() {
+        size_t total = 0;
+        Fields::forEachField<Struct>([&](auto descriptor) {
+            typedef std::remove_cv_t<std::remove_reference_t<decltype(std::declval<Struct>().*(descriptor.member))>> MemberType;
+            typedef typename Fields::ElementType<MemberType>::type ItemType;
+            total += Fields::ElementType<MemberType>::count * (std::is_same<ItemType, bool>::value ? 1 : sizeof(ItemType));
+        });
+        return total;
+    }
+
+    /*
+     * Loads what writeBinary() wrote. Returns false (and might have modified some fields)
+     * if the size does not match.
+     */
+    template <class Struct>
+    bool readBinary(Struct & data, const char * buffer, size_t size) {
+        if (size != binarySize<Struct>())
+            return false;
+
+        size_t offset = 0;
+        Fields::forEachField<Struct>([&](auto descriptor) {
+            auto & value = data.*(descriptor.member);
+            typedef std::remove_cv_t<std::remove_reference_t<decltype(value)>> MemberType;
+            typedef typename Fields::ElementType<MemberType>::type ItemType;
+            ItemType * items = Fields::elements(value);
+            if constexpr (std::is_same<ItemType, bool>::value) {
+                for (size_t i = 0; i < Fields::ElementType<MemberType>::count; i++)
+                    items[i] = buffer[offset++] != 0;
+            } else {
+                memcpy(items, buffer + offset, sizeof(MemberType));
+                offset += sizeof(MemberType);
+            }
+        });
+        return true;
+    }
+
+    /*
+     * Loads a "<value>&<value>&..." list (a trailing '&' is optional). It must contain exactly
+     * one value per field (or array element). Returns false (and might have modified some
+     * fields) otherwise.
+     *
+     * If lenient, whitespace around the values (e.g., a trailing newline) and extra values after
+     * the last field are accepted, as the stream-based parsers of some requests used to.
+     */
+    template <class Struct>
+    bool readValueList(Struct & data, const char * buffer, size_t size, bool lenient = false) {
+        const char * position = buffer;
+        const char * end = buffer + size;
+        bool succeeded = true;
+        Fields::forEachField<Struct>([&](auto descriptor) {
+            auto & value = data.*(descriptor.member);
+            typedef std::remove_cv_t<std::remove_reference_t<decltype(value)>> MemberType;
+            auto * items = Fields::elements(value);
+            for (size_t i = 0; i < Fields::ElementType<MemberType>::count && succeeded; i++) {
+                const char * separator = position;
+                while (separator < end && *separator != '&')
+                    separator++;
+                const char * first = position;
+                const char * last = separator;
+                if (lenient) {
+                    while (first < last && isspace((unsigned char)*first))
+                        first++;
+                    while (last > first && isspace((unsigned char)*(last - 1)))
+                        last--;
+                }
+                succeeded = position < end && Fields::readText(first, last, items[i]);
+                position = separator < end ? separator + 1 : end;
+            }
+        });
+        return succeeded && (lenient || position == end);
+    }
+}
+
+#endif
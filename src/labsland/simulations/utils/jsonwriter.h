@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef SIMULATION_JSON_WRITER_H
+#define SIMULATION_JSON_WRITER_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <charconv>
+#include <string_view>
+#include <type_traits>
+
+#include "fields.h"
+
+/*
+ * Streaming JSON writer for the reports of the simulations. It writes into a buffer
+ * provided by the caller (no heap is used), adding the commas and escaping the strings:
+ *
+ *     size_t serializeTo(char * buffer, size_t size) const override {
+ *         JsonWriter json(buffer, size);
+ *         json.beginObject()
+ *                 .field("level", level)
+ *                 .field("text", std::string_view(text))
+ *             .endObject();
+ *         return json.getLength();
+ *     }
+ *
+ * Like FixedBufferWriter, the length keeps counting once the buffer is full, so the caller
+ * can tell the size required. Numbers are formatted with std::to_chars (the shortest text
+ * that reads back to the same value); NaN and infinity are written as null.
+ */
+namespace LabsLand::Simulations::Utils {
+
+    class JsonWriter {
+        private:
+            static constexpr int MAX_DEPTH = 32;
+
+            FixedBufferWriter writer;
+            int depth = 0;
+            // Bit n is set while no value has been written yet at depth n
+            uint32_t emptyLevels = 1;
+            bool afterKey = false;
+
+            void beginValue() {
+                if (afterKey) {
+                    afterKey = false;
+                    return;
+                }
+                uint32_t levelBit = (uint32_t)1 << depth;
+                if ((emptyLevels & levelBit) == 0)
+                    writer.append(',');
+                emptyLevels &= ~levelBit;
+            }
+
+            void beginLevel(char opening) {
+                beginValue();
+                writer.append(opening);
+                if (depth < MAX_DEPTH - 1)
+                    depth++;
+                emptyLevels |= (uint32_t)1 << depth;
+            }
+
+            void endLevel(char closing) {
+                writer.append(closing);
+                if (depth > 0)
+                    depth--;
+            }
+
+            static bool needsEscape(unsigned char c) {
+                // One bit per character: control characters, '"' and '\\'
+                static constexpr uint64_t ESCAPED[4] = { 0x00000004ffffffffull, 0x0000000010000000ull, 0, 0 };
+                return (ESCAPED[c >> 6] >> (c & 63)) & 1;
+            }
+
+            /*
+             * Whether any of the 8 characters in word needs escaping (checked all at once).
+             */
+            static bool wordNeedsEscape(uint64_t word) {
+                const uint64_t ONES = 0x0101010101010101ull;
+                const uint64_t HIGH = 0x8080808080808080ull;
+                uint64_t quotes = word ^ (ONES * '"');
+                uint64_t backslashes = word ^ (ONES * '\\');
+                return (((word - ONES * 0x20) & ~word)
+                        | ((quotes - ONES) & ~quotes)
+                        | ((backslashes - ONES) & ~backslashes)) & HIGH;
+            }
+
+            void writeString(std::string_view text) {
+                static const char HEX[] = "0123456789abcdef";
+                writer.append('"');
+                size_t pending = 0; // start of the characters that do not need escaping
+                size_t i = 0;
+                while (i < text.size()) {
+                    // Skip the runs of characters that do not need escaping 8 at a time
+                    uint64_t word;
+                    if (i + sizeof(word) <= text.size()) {
+                        memcpy(&word, text.data() + i, sizeof(word));
+                        if (!wordNeedsEscape(word)) {
+                            i += sizeof(word);
+                            continue;
+                        }
+                    }
+
+                    unsigned char c = (unsigned char)text[i++];
+                    if (!needsEscape(c))
+                        continue;
+
+                    writer.append(text.data() + pending, i - 1 - pending);
+                    pending = i;
+                    writer.append('\\');
+                    switch (c) {
+                        case '"': writer.append('"'); break;
+                        case '\\': writer.append('\\'); break;
+                        case '\b': writer.append('b'); break;
+                        case '\f': writer.append('f'); break;
+                        case '\n': writer.append('n'); break;
+                        case '\r': writer.append('r'); break;
+                        case '\t': writer.append('t'); break;
+                        default:
+                            writer.append("u00", 3);
+                            writer.append(HEX[c >> 4]);
+                            writer.append(HEX[c & 0xf]);
+                    }
+                }
+                writer.append(text.data() + pending, text.size() - pending);
+                writer.append('"');
+            }
+
+            template <class T>
+            void writeNumber(T number) {
+                char text[32];
+                if constexpr (std::is_floating_point<T>::value) {
+                    if (!std::isfinite(number)) {
+                        writer.append("null", 4);
+                        return;
+                    }
+                }
+                std::to_chars_result result = std::to_chars(text, text + sizeof(text), number);
+                writer.append(text, result.ptr - text);
+            }
+
+        public:
+            JsonWriter(char * buffer, size_t size): writer(buffer, size) {}
+
+            JsonWriter & beginObject() {
+                beginLevel('{');
+                return *this;
+            }
+
+            JsonWriter & endObject() {
+                endLevel('}');
+                return *this;
+            }
+
+            JsonWriter & beginArray() {
+                beginLevel('[');
+                return *this;
+            }
+
+            JsonWriter & endArray() {
+                endLevel(']');
+                return *this;
+            }
+
+            JsonWriter & key(std::string_view name) {
+                beginValue();
+                writeString(name);
+                writer.append(':');
+                afterKey = true;
+                return *this;
+            }
+
+            JsonWriter & value(std::string_view text) {
+                beginValue();
+                writeString(text);
+                return *this;
+            }
+
+            JsonWriter & value(const char * text) {
+                return value(std::string_view(text));
+            }
+
+            JsonWriter & value(bool boolean) {
+                beginValue();
+                if (boolean)
+                    writer.append("true", 4);
+                else
+                    writer.append("false", 5);
+                return *this;
+            }
+
+            JsonWriter & value(std::nullptr_t) {
+                beginValue();
+                writer.append("null", 4);
+                return *this;
+            }
+
+            template <class T, typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, int>::type = 0>
+            JsonWriter & value(T number) {
+                beginValue();
+                writeNumber(number);
+                return *this;
+            }
+
+            /*
+             * Shortcut for key(name).value(fieldValue).
+             */
+            template <class T>
+            JsonWriter & field(std::string_view name, T fieldValue) {
+                key(name);
+                return value(fieldValue);
+            }
+
+            /*
+             * Number of characters written (or that would have been written if the buffer was big enough).
+             */
+            size_t getLength() const {
+                return writer.getLength();
+            }
+
+            bool overflowed() const {
+                return writer.overflowed();
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef SIMULATION_QUERY_ARGS_H
+#define SIMULATION_QUERY_ARGS_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+#include "fields.h"
+
+/*
+ * Allocation-free parsing of "foo=1&bar=2&baz" messages (see BaseInputDataType::parseQueryArgs).
+ *
+ * The keys and values point to the parsed input, so it must outlive the QueryArgs. The variable
+ * names a simulation knows about can be declared at compile time:
+ *
+ *     static constexpr auto VARIABLES = queryVariables("speed", "clearing", "text");
+ *
+ *     QueryArgs<> args;
+ *     if (!args.parse(input, VARIABLES) || !args.hasAll(VARIABLES.maskOf("speed") | VARIABLES.maskOf("clearing")))
+ *         return false;
+ *     args.get("speed", this->speed);
+ *
+ * so each key is hashed once while parsing, and checking the required variables is a single
+ * comparison of bitmasks.
+ */
+namespace LabsLand::Simulations::Utils {
+
+    /*
+     * 32-bit FNV-1a, usable at compile time.
+     */
+    constexpr uint32_t hashQueryKey(std::string_view key) {
+        uint32_t hash = 2166136261u;
+        for (char c : key) {
+            hash ^= (uint8_t)c;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /*
+     * Calls function(key, value) for each variable of the input, in order. Variables without
+     * '=' have "1" as value, and empty variables ("foo&&bar") are skipped.
+     */
+    template <class Function>
+    void forEachQueryArg(std::string_view input, Function function) {
+        while (!input.empty()) {
+            size_t posAnd = input.find('&');
+            std::string_view currentVariable = input.substr(0, posAnd);
+            input = posAnd == std::string_view::npos ? std::string_view() : input.substr(posAnd + 1);
+            if (currentVariable.empty())
+                continue;
+
+            size_t posEquals = currentVariable.find('=');
+            if (posEquals == std::string_view::npos) {
+                // foo&bar means that foo=1 and bar=1
+                function(currentVariable, std::string_view("1"));
+            } else {
+                function(currentVariable.substr(0, posEquals), currentVariable.substr(posEquals + 1));
+            }
+        }
+    }
+
+    /*
+     * Up to 64 variable names known at compile time, each of them with a bit in the masks.
+     */
+    template <size_t N>
+    struct QueryVariables {
+        static_assert(N <= 64, "Up to 64 known variables are supported");
+
+        std::array<std::string_view, N> names;
+        std::array<uint32_t, N> hashes;
+
+        constexpr int indexOf(std::string_view key, uint32_t keyHash) const {
+            for (size_t i = 0; i < N; i++)
+                if (hashes[i] == keyHash && names[i] == key)
+                    return (int)i;
+            return -1;
+        }
+
+        constexpr int indexOf(std::string_view key) const {
+            return indexOf(key, hashQueryKey(key));
+        }
+
+        /*
+         * Bit of the variable (0 if it is not known).
+         */
+        constexpr uint64_t maskOf(std::string_view name) const {
+            int index = indexOf(name);
+            return index < 0 ? 0 : (uint64_t)1 << index;
+        }
+
+        constexpr uint64_t allMask() const {
+            return N == 64 ? ~(uint64_t)0 : ((uint64_t)1 << N) - 1;
+        }
+    };
+
+    template <class... Names>
+    constexpr QueryVariables<sizeof...(Names)> queryVariables(Names... names) {
+        QueryVariables<sizeof...(Names)> variables = {};
+        const char * list[] = { names... };
+        for (size_t i = 0; i < sizeof...(Names); i++) {
+            variables.names[i] = list[i];
+            variables.hashes[i] = hashQueryKey(variables.names[i]);
+        }
+        return variables;
+    }
+
+    struct QueryArg {
+        std::string_view key;
+        std::string_view value;
+        uint32_t keyHash;
+        // Index in the QueryVariables passed to parse() (-1 if unknown or none was passed)
+        int knownIndex;
+    };
+
+    /*
+     * Fixed-capacity flat list of the variables of a message.
+     */
+    template <size_t Capacity = 16>
+    class QueryArgs {
+        private:
+            std::array<QueryArg, Capacity> args;
+            size_t count = 0;
+            uint64_t knownMask = 0;
+
+            template <class Known>
+            bool parseWith(std::string_view input, const Known & known) {
+                count = 0;
+                knownMask = 0;
+                bool fits = true;
+                forEachQueryArg(input, [&](std::string_view key, std::string_view value) {
+                    if (count == Capacity) {
+                        fits = false;
+                        return;
+                    }
+                    uint32_t keyHash = hashQueryKey(key);
+                    int knownIndex = known(key, keyHash);
+                    if (knownIndex >= 0)
+                        knownMask |= (uint64_t)1 << knownIndex;
+                    args[count++] = { key, value, keyHash, knownIndex };
+                });
+                return fits;
+            }
+
+        public:
+            /*
+             * Returns false if the input has more than Capacity variables (the first
+             * Capacity ones are kept).
+             */
+            bool parse(std::string_view input) {
+                return parseWith(input, [](std::string_view, uint32_t) { return -1; });
+            }
+
+            template <size_t N>
+            bool parse(std::string_view input, const QueryVariables<N> & known) {
+                return parseWith(input, [&known](std::string_view key, uint32_t keyHash) { return known.indexOf(key, keyHash); });
+            }
+
+            size_t size() const {
+                return count;
+            }
+
+            const QueryArg & operator[](size_t index) const {
+                return args[index];
+            }
+
+            /*
+             * Last occurrence of the key (nullptr if it is not present).
+             */
+            const QueryArg * find(std::string_view key) const {
+                uint32_t keyHash = hashQueryKey(key);
+                for (size_t i = count; i > 0; i--)
+                    if (args[i - 1].keyHash == keyHash && args[i - 1].key == key)
+                        return &args[i - 1];
+                return nullptr;
+            }
+
+            bool contains(std::string_view key) const {
+                return find(key) != nullptr;
+            }
+
+            std::string_view get(std::string_view key, std::string_view defaultValue = std::string_view()) const {
+                const QueryArg * arg = find(key);
+                return arg == nullptr ? defaultValue : arg->value;
+            }
+
+            /*
+             * Parses the value of the key as a number or bool (see Fields::readText). Returns
+             * false (leaving value untouched) if it is missing or it is not valid.
+             */
+            template <class T>
+            bool get(std::string_view key, T & value) const {
+                const QueryArg * arg = find(key);
+                T parsed;
+                if (arg == nullptr || !Fields::readText(arg->value.data(), arg->value.data() + arg->value.size(), parsed))
+                    return false;
+                value = parsed;
+                return true;
+            }
+
+            /*
+             * Bits (see QueryVariables::maskOf) of the known variables found by parse().
+             */
+            uint64_t getKnownMask() const {
+                return knownMask;
+            }
+
+            bool hasAll(uint64_t requiredMask) const {
+                return (knownMask & requiredMask) == requiredMask;
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef SIMULATION_REPORT_RATE_POLICY_H
+#define SIMULATION_REPORT_RATE_POLICY_H
+
+namespace LabsLand::Simulations::Utils {
+
+    /*
+     * What happened in the last report cycle of a simulation, as seen by the Simulation.
+     */
+    struct ReportRateFeedback {
+        // A report was handed to the communicator in this cycle
+        bool reported;
+        // The communicator published a new report since the previous cycle (that is, the state
+        // changed: communicators do not publish a report identical to the previous one)
+        bool changed;
+        // The consumer (web server) acknowledged reading reports since the previous cycle
+        bool acknowledged;
+        // Whether the communicator supports acknowledgements at all. If it does not,
+        // acknowledged is always false and policies should not rely on it.
+        bool acknowledgementsSupported;
+    };
+
+    /*
+     * Decides how often the state of a simulation is reported to the virtual environment. The
+     * Simulation calls nextPeriod() after each report cycle and waits the returned number of
+     * seconds until the next one.
+     */
+    class ReportRatePolicy {
+        public:
+            virtual ~ReportRatePolicy() {}
+
+            virtual float nextPeriod(float currentPeriod, const ReportRateFeedback & feedback) = 0;
+    };
+
+    /*
+     * Always the same period (the behavior of a Simulation without policy).
+     */
+    class FixedReportRatePolicy : public ReportRatePolicy {
+        private:
+            float period;
+
+        public:
+            FixedReportRatePolicy(float period = 0.5): period(period) {}
+
+            float nextPeriod(float currentPeriod, const ReportRateFeedback & feedback) override {
+                return period;
+            }
+    };
+
+    /*
+     * Reports faster while the state is changing and the consumer is reading the reports,
+     * and slower when nothing changes or nobody reads them:
+     *
+     *  - changed and acknowledged:   the period is halved, down to minPeriod.
+     *  - not changed, acknowledged:  the period grows by 50%, up to idlePeriod.
+     *  - not acknowledged:           the period doubles, up to maxPeriod.
+     *
+     * With communicators without acknowledgements, the consumer is assumed to be reading.
+     */
+    class AdaptiveReportRatePolicy : public ReportRatePolicy {
+        private:
+            float minPeriod;
+            float idlePeriod;
+            float maxPeriod;
+
+        public:
+            AdaptiveReportRatePolicy(float minPeriod = 0.02, float idlePeriod = 0.5, float maxPeriod = 2.0):
+                minPeriod(minPeriod), idlePeriod(idlePeriod), maxPeriod(maxPeriod) {}
+
+            float nextPeriod(float currentPeriod, const ReportRateFeedback & feedback) override {
+                bool consumerReading = feedback.acknowledged || !feedback.acknowledgementsSupported;
+                float period;
+                if (!consumerReading) {
+                    period = currentPeriod * 2;
+                    return period > maxPeriod ? maxPeriod : period;
+                }
+
+                if (feedback.changed) {
+                    period = currentPeriod / 2;
+                    return period < minPeriod ? minPeriod : period;
+                }
+
+                // Nothing changed: back off, but never beyond idlePeriod (and come back
+                // to it if the consumer was not reading before)
+                if (currentPeriod > idlePeriod)
+                    return idlePeriod;
+                period = currentPeriod * 1.5f;
+                return period > idlePeriod ? idlePeriod : period;
+            }
+    };
+}
+
+#endif
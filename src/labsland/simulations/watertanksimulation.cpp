@@ -29,14 +29,26 @@ void WatertankSimulation::initialize() {
 
     mState.pump1Active = true;
     mState.pump2Active = true;
+    mState.pump1Temperature = 0;
+    mState.pump2Temperature = 0;
+    mState.currentLoad = 0;
 
     setReportWhenMarked(true);
+    // The tank changes slowly: back off while it is stable or nobody is reading the reports
+    setReportRatePolicy(std::make_shared<LabsLand::Simulations::Utils::AdaptiveReportRatePolicy>());
+    // In the event mode, only update while the level is changing (see the end of update())
+    setEventDriven(true);
 }
 
 
  void WatertankSimulation::update(double delta) {
 
-    this->log() << "Updating simulation. Delta: " << delta << std::endl;
+    LL_LOG(Debug) << "Updating simulation. Delta: " << delta << std::endl;
+
+    // In the event mode, nothing updates the tank while its level is stable, so delta may be the whole idle
+    // interval (minutes). The pumps and the demand of that interval are the previous ones, which kept the level
+    // where it is: the new ones only apply from now on.
+    double flowDelta = mLevelStable ? 0 : delta;
 
     // Check if we have received any interaction from the 3D environment.
     // TO-DO: Maybe a better API would be exception-based so that it can return by value and be slightly more explicit.
@@ -54,24 +66,24 @@ void WatertankSimulation::initialize() {
     mState.pump1Active = this->targetDevice->getGpio("pump1");
     mState.pump2Active = this->targetDevice->getGpio("pump2");
 
-    this->log() << "Pumps: pump1: " << mState.pump1Active << "; pump2: " << mState.pump2Active << std::endl;
+    LL_LOG(Debug) << "Pumps: pump1: " << mState.pump1Active << "; pump2: " << mState.pump2Active << std::endl;
 
     if(mState.pump1Active) {
         // Pump1 is adding water at PUMP1_FLOWRATE liters per second.
-        addedWater += PUMP1_FLOWRATE * delta;
+        addedWater += PUMP1_FLOWRATE * flowDelta;
     }
 
     if(mState.pump2Active) {
         // Pump2 is adding water at PUMP2_FLOWRATE liters per second.
-        addedWater += PUMP2_FLOWRATE * delta;
+        addedWater += PUMP2_FLOWRATE * flowDelta;
     }
 
     // Water is being removed from the watertank to satisfy the dynamic
     // demand.
     float removedWater = 0;
-    removedWater = mCurrentDemandFlowrate * delta;
+    removedWater = mCurrentDemandFlowrate * flowDelta;
 
-    this->log() << "Old volume: " << mState.volume << "; adding: " << addedWater << "; removing (flow rate=" << mCurrentDemandFlowrate << "): " << removedWater << std::endl;
+    LL_LOG(Debug) << "Old volume: " << mState.volume << "; adding: " << addedWater << "; removing (flow rate=" << mCurrentDemandFlowrate << "): " << removedWater << std::endl;
 
     // Update the volume.
     mState.volume = mState.volume + addedWater - removedWater;
@@ -85,17 +97,25 @@ void WatertankSimulation::initialize() {
 
     mState.level = mState.volume / mState.totalVolume;
 
-    this->log() << "New volume: " << mState.volume << "; which is level=" << mState.level << std::endl;
+    LL_LOG(Debug) << "New volume: " << mState.volume << "; which is level=" << mState.level << std::endl;
 
     // Update the state of the level sensors according to the watertank level.
     mState.lowSensorActive = mState.level >= 0.20;
     mState.midSensorActive = mState.level >= 0.50;
     mState.highSensorActive = mState.level >= 0.80;
-    this->log() << "Sensors: Low (0.2): " << mState.lowSensorActive << "; Mid (0.5): " << mState.midSensorActive << "; High (0.8): " << mState.highSensorActive << std::endl;
+    LL_LOG(Debug) << "Sensors: Low (0.2): " << mState.lowSensorActive << "; Mid (0.5): " << mState.midSensorActive << "; High (0.8): " << mState.highSensorActive << std::endl;
 
     this->targetDevice->setGpio("lowSensorActive", mState.lowSensorActive);
     this->targetDevice->setGpio("midSensorActive", mState.midSensorActive);
     this->targetDevice->setGpio("highSensorActive", mState.highSensorActive);
     requestReportState();
+
+    // While the level changes, come back in a step. Once it is stable (the flows are balanced, or the tank is
+    // full or empty) nothing changes until the pumps or the demand do, so there is no need to update until then.
+    float netFlowrate = (mState.pump1Active ? PUMP1_FLOWRATE : 0) + (mState.pump2Active ? PUMP2_FLOWRATE : 0) - mCurrentDemandFlowrate;
+    bool levelChanging = (netFlowrate > 0 && mState.volume < mState.totalVolume) || (netFlowrate < 0 && mState.volume > 0);
+    mLevelStable = !levelChanging;
+    cancelWakeup(mStepWakeup);
+    mStepWakeup = levelChanging ? scheduleWakeup(getSleepStepInMs() / 1000.0) : LabsLand::Utils::TimerWheel::INVALID_TIMER;
 }
 
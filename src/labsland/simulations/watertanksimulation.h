@@ -46,15 +46,37 @@ struct WatertankData : public BaseOutputDataType {
     bool midSensorActive;
     bool highSensorActive;
 
+    static constexpr auto fields() {
+        using namespace LabsLand::Simulations::Utils;
+        return describeFields(
+            field("level", &WatertankData::level),
+            field("totalVolume", &WatertankData::totalVolume),
+            field("volume", &WatertankData::volume),
+            field("pump1Active", &WatertankData::pump1Active),
+            field("pump2Active", &WatertankData::pump2Active),
+            field("pump1Temperature", &WatertankData::pump1Temperature),
+            field("pump2Temperature", &WatertankData::pump2Temperature),
+            field("currentLoad", &WatertankData::currentLoad),
+            field("lowSensorActive", &WatertankData::lowSensorActive),
+            field("midSensorActive", &WatertankData::midSensorActive),
+            field("highSensorActive", &WatertankData::highSensorActive)
+        );
+    }
+
     /**
-     * Serializes the structure into a string that can be transmitted through serial.
+     * Serializes the structure into a string that can be transmitted through serial,
+     * as "<level>&<totalVolume>&...&<highSensorActive>&".
      */
     std::string serialize() const {
-        std::stringstream stream;
-        stream << level << "&" << totalVolume << "&" << volume << "&" << pump1Active << "&" << pump2Active << "&" <<
-            pump1Temperature << "&" << pump2Temperature << "&" << currentLoad << "&" << lowSensorActive << "&" <<
-            midSensorActive << "&" << highSensorActive << "&";
-        return stream.str();
+        return serializeToString();
+    }
+
+    size_t serializeTo(char * buffer, size_t size) const override {
+        return LabsLand::Simulations::Utils::writeValueList(*this, buffer, size);
+    }
+
+    size_t serializeBinary(char * buffer, size_t size) const override {
+        return LabsLand::Simulations::Utils::writeBinary(*this, buffer, size);
     }
 };
 
@@ -65,10 +87,13 @@ struct WatertankData : public BaseOutputDataType {
 struct WatertankRequest : public BaseInputDataType {
     float outputFlow;
 
+    static constexpr auto fields() {
+        using namespace LabsLand::Simulations::Utils;
+        return describeFields(field("outputFlow", &WatertankRequest::outputFlow));
+    }
+
     bool deserialize(std::string const & input) {
-        std::stringstream stream(input);
-        stream >> outputFlow;
-        return true;
+        return LabsLand::Simulations::Utils::readValueList(*this, input.data(), input.size(), true);
     }
 };
 
@@ -93,6 +118,11 @@ private:
 
     float mCurrentDemandFlowrate = 60; // liters per second.
 
+    // Wakeup of the next step while the level is changing (in the event mode)
+    LabsLand::Utils::TimerWheel::TimerId mStepWakeup = LabsLand::Utils::TimerWheel::INVALID_TIMER;
+    // Whether the last update left the level stable (so the flows since then did not change it)
+    bool mLevelStable = false;
+
 public:
 
     WatertankSimulation() = default;
@@ -100,6 +130,11 @@ public:
     virtual void update(double delta) override;
 
     virtual void initialize() override;
+
+    // The tank changes slowly: 10 updates per second are enough
+    virtual uint32_t getSleepStepInMs() override {
+        return 100;
+    }
 };
 
 
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LL_LOGGING
+#define LL_LOGGING
+
+#include <ostream>
+#include <string>
+
+/*
+ * Messages below this level are removed at compile time (0: trace, 1: debug, 2: info, 3: warning,
+ * 4: error). E.g., build with -DLL_LOG_MIN_LEVEL=2 to leave only info and above in the binary.
+ */
+#ifndef LL_LOG_MIN_LEVEL
+#define LL_LOG_MIN_LEVEL 0
+#endif
+
+/*
+ * Logs a message with a level from a simulation (or a target device), e.g.:
+ *
+ *     LL_LOG(Debug) << "Volume: " << mState.volume << std::endl;
+ *
+ * If the level is disabled (at compile time or with setLogLevel()), nothing after LL_LOG(...) is
+ * evaluated, so the message is not even formatted. Only whole statements should follow it.
+ */
+#define LL_LOG(level) \
+    !((int)LabsLand::Utils::LogLevel::level >= LL_LOG_MIN_LEVEL && this->isLogEnabled(LabsLand::Utils::LogLevel::level)) \
+        ? (void)0 : LabsLand::Utils::LogVoidify() & this->log(LabsLand::Utils::LogLevel::level)
+
+namespace LabsLand::Utils {
+
+    enum class LogLevel {
+        Trace = 0,  // Very frequent details (e.g., every bit read)
+        Debug = 1,  // The state of every update
+        Info = 2,   // Events (e.g., requests, transitions). Plain log() calls use this level
+        Warning = 3,
+        Error = 4,
+        Off = 5
+    };
+
+    /*
+     * Parses "trace", "debug", "info", "warning", "error" or "off". Returns false if it is not a level.
+     */
+    inline bool parseLogLevel(const std::string & name, LogLevel & level) {
+        static const char * names[] = { "trace", "debug", "info", "warning", "error", "off" };
+        for (int i = 0; i <= (int)LogLevel::Off; i++) {
+            if (name == names[i]) {
+                level = (LogLevel)i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*
+     * A stream that discards everything, for the disabled levels.
+     */
+    inline std::ostream & nullLogStream() {
+        thread_local std::ostream discard(nullptr);
+        return discard;
+    }
+
+    // Turns the stream expression of LL_LOG into void, so both branches of the ?: match
+    struct LogVoidify {
+        void operator&(std::ostream &) {}
+    };
+
+}
+
+#endif
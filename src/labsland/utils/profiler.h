@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LL_PROFILER
+#define LL_PROFILER
+
+/*
+ * Per-phase timing of the simulation ticks, only compiled with -DLL_PROFILING (the CMake option of the
+ * same name). Without it, LL_PROFILE_SCOPE() expands to nothing and none of this is compiled.
+ */
+#ifdef LL_PROFILING
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#define LL_PROFILE_CONCAT_INNER(a, b) a##b
+#define LL_PROFILE_CONCAT(a, b) LL_PROFILE_CONCAT_INNER(a, b)
+
+/*
+ * Times the rest of the enclosing block as the given ProfilePhase of profiler (a Profiler *, which may be null).
+ */
+#define LL_PROFILE_SCOPE(profiler, phase) \
+    LabsLand::Utils::ProfileScope LL_PROFILE_CONCAT(llProfileScope, __LINE__)((profiler), LabsLand::Utils::ProfilePhase::phase)
+
+namespace LabsLand::Utils {
+
+    /*
+     * The phases nest: a Tick (Simulation::_update()) contains the Update (update() and the fixed steps) and
+     * the Report (reportUpdate()); the Update contains the TargetDeviceIO it does; the Report contains the
+     * CommunicatorIO, which contains the Serialization of the report. Requests is the reading of requests
+     * (with their onRequest() if they are dispatched, see Simulation::setDispatchRequests()).
+     */
+    enum class ProfilePhase {
+        Tick = 0,
+        Update,
+        Requests,
+        Report,
+        Serialization,
+        CommunicatorIO,
+        TargetDeviceIO,
+        Count
+    };
+
+    inline const char * getProfilePhaseName(ProfilePhase phase) {
+        static const char * names[] = { "tick", "update", "requests", "report", "serialization", "communicator_io", "target_device_io" };
+        return names[(int)phase];
+    }
+
+    /**
+     * HDR-style histogram of durations in nanoseconds: each power of two is split in SUB_BUCKETS linear
+     * buckets, so any value is recorded with a relative error below 1 / SUB_BUCKETS (6.25%), from 1 ns
+     * to 2^40 ns (~18 minutes), in a fixed array (recording never allocates).
+     */
+    class LatencyHistogram {
+        public:
+            static const int SUB_BUCKET_BITS = 4;
+            static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+            static const int MAX_BITS = 40;
+            static const int BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        private:
+            uint32_t counts[BUCKETS] = {};
+            uint64_t samples = 0;
+            uint64_t totalNs = 0;
+            uint64_t maxNs = 0;
+
+            static int bucketOf(uint64_t ns) {
+                if (ns < SUB_BUCKETS)
+                    return (int)ns;
+                int bits = 64 - __builtin_clzll(ns);
+                if (bits > MAX_BITS)
+                    return BUCKETS - 1;
+                // The bits after the most significant one select the sub-bucket
+                int shift = bits - SUB_BUCKET_BITS - 1;
+                return (shift + 1) * SUB_BUCKETS + (int)((ns >> shift) - SUB_BUCKETS);
+            }
+
+            // Highest value recorded in a bucket
+            static uint64_t bucketMax(int bucket) {
+                if (bucket < SUB_BUCKETS)
+                    return bucket;
+                int shift = bucket / SUB_BUCKETS - 1;
+                uint64_t first = (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+                return first + ((uint64_t)1 << shift) - 1;
+            }
+
+        public:
+            void record(uint64_t ns) {
+                counts[bucketOf(ns)]++;
+                samples++;
+                totalNs += ns;
+                if (ns > maxNs)
+                    maxNs = ns;
+            }
+
+            uint64_t getSamples() const {
+                return samples;
+            }
+
+            double getMeanNs() const {
+                return samples > 0 ? (double)totalNs / samples : 0;
+            }
+
+            uint64_t getMaxNs() const {
+                return maxNs;
+            }
+
+            /*
+             * The value below which the given fraction (e.g., 0.99) of the samples are.
+             */
+            uint64_t getPercentileNs(double fraction) const {
+                uint64_t target = (uint64_t)(fraction * samples + 0.5);
+                if (target == 0)
+                    target = 1;
+                uint64_t accumulated = 0;
+                for (int bucket = 0; bucket < BUCKETS; bucket++) {
+                    accumulated += counts[bucket];
+                    if (accumulated >= target)
+                        return bucketMax(bucket) < maxNs ? bucketMax(bucket) : maxNs;
+                }
+                return maxNs;
+            }
+
+            void reset() {
+                *this = LatencyHistogram();
+            }
+    };
+
+    /**
+     * A histogram per phase. Not thread-safe: it is meant to be used by the thread that updates the simulation.
+     */
+    class Profiler {
+        private:
+            LatencyHistogram histograms[(int)ProfilePhase::Count];
+
+        public:
+            void record(ProfilePhase phase, uint64_t ns) {
+                histograms[(int)phase].record(ns);
+            }
+
+            const LatencyHistogram & getHistogram(ProfilePhase phase) const {
+                return histograms[(int)phase];
+            }
+
+            /*
+             * Writes the percentiles of every phase as a line of JSON:
+             * {"time_us":...,"phases":{"tick":{"count":...,"mean_ns":...,"p50_ns":...,"p90_ns":...,"p99_ns":...,"p999_ns":...,"max_ns":...},...}}
+             */
+            void writeJsonLine(std::ostream & output, uint64_t timeUs) const {
+                output << "{\"time_us\":" << timeUs << ",\"phases\":{";
+                for (int phase = 0; phase < (int)ProfilePhase::Count; phase++) {
+                    const LatencyHistogram & histogram = histograms[phase];
+                    output << (phase > 0 ? "," : "") << "\"" << getProfilePhaseName((ProfilePhase)phase) << "\":{"
+                           << "\"count\":" << histogram.getSamples()
+                           << ",\"mean_ns\":" << (uint64_t)histogram.getMeanNs()
+                           << ",\"p50_ns\":" << histogram.getPercentileNs(0.5)
+                           << ",\"p90_ns\":" << histogram.getPercentileNs(0.9)
+                           << ",\"p99_ns\":" << histogram.getPercentileNs(0.99)
+                           << ",\"p999_ns\":" << histogram.getPercentileNs(0.999)
+                           << ",\"max_ns\":" << histogram.getMaxNs() << "}";
+                }
+                output << "}}\n";
+            }
+
+            void reset() {
+                for (LatencyHistogram & histogram : histograms)
+                    histogram.reset();
+            }
+    };
+
+    /**
+     * Records the time from its construction to its destruction in a phase of a profiler.
+     */
+    class ProfileScope {
+        private:
+            Profiler * profiler;
+            ProfilePhase phase;
+            std::chrono::steady_clock::time_point start;
+
+        public:
+            ProfileScope(Profiler * profiler, ProfilePhase phase): profiler(profiler), phase(phase) {
+                if (profiler != nullptr)
+                    start = std::chrono::steady_clock::now();
+            }
+
+            ~ProfileScope() {
+                if (profiler != nullptr)
+                    profiler->record(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            }
+
+            ProfileScope(const ProfileScope &) = delete;
+            ProfileScope & operator=(const ProfileScope &) = delete;
+    };
+
+}
+
+#else
+
+#define LL_PROFILE_SCOPE(profiler, phase)
+
+#endif
+
+#endif
@@ -9,6 +9,7 @@
 #define LL_TIME_MANAGER
 
 #include <atomic>
+#include <cstdint>
 
 namespace LabsLand::Utils {
 
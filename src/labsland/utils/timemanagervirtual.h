@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LL_TIME_MANAGER_VIRTUAL
+#define LL_TIME_MANAGER_VIRTUAL
+
+#include <atomic>
+#include <cstdint>
+
+#include "timemanager.h"
+
+namespace LabsLand::Utils {
+
+    /**
+     * A TimeManager whose time only moves when it is told to: the runner advances it
+     * explicitly between updates, and sleeping advances it instead of blocking. This way
+     * simulations run as fast as the processor allows, with exact and reproducible deltas.
+     *
+     * Time is in microseconds, starting at the given value.
+     */
+    class TimeManagerVirtual : public TimeManager {
+        private:
+            // Mutable since sleeping (a const operation of TimeManager) advances it
+            mutable std::atomic<clock_t> currentTime;
+
+        public:
+            TimeManagerVirtual(clock_t startTime = 0): currentTime(startTime) {}
+
+            // advances the time a number of milliseconds
+            virtual void sleepMs(uint32_t ms) const override {
+                currentTime.fetch_add((clock_t)ms * 1000, std::memory_order_relaxed);
+            }
+
+            // advances the time a number of microseconds
+            virtual void sleepUs(uint32_t us) const override {
+                currentTime.fetch_add(us, std::memory_order_relaxed);
+            }
+
+            // virtual time in microseconds
+            virtual clock_t getAbsoluteTime() const override {
+                return currentTime.load(std::memory_order_relaxed);
+            }
+
+            virtual uint64_t getClocksPerSec() const override {
+                return 1000000;
+            }
+
+            void advanceUs(uint64_t us) {
+                currentTime.fetch_add(us, std::memory_order_relaxed);
+            }
+
+            void setTime(clock_t time) {
+                currentTime.store(time, std::memory_order_relaxed);
+            }
+    };
+
+}
+
+#endif
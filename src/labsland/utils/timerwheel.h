@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2023 onwards LabsLand, Inc.
+ * All rights reserved.
+ *
+ * This software is licensed as described in the file LICENSE, which
+ * you should have received as part of this distribution.
+ */
+#ifndef LL_TIMER_WHEEL
+#define LL_TIMER_WHEEL
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "timemanager.h"
+
+namespace LabsLand::Utils {
+
+    /**
+     * Hierarchical timer wheel: scheduling and cancelling a timer is O(1), and so is advancing the
+     * time by one tick. Timers are kept in 4 levels of 64 slots: the first level has one slot per
+     * tick, the second one per 64 ticks, etc. When the time reaches a slot of an upper level, its
+     * timers are moved down to the level below (cascaded), until they reach the first level and fire.
+     *
+     * Times are in clocks of the TimeManager (clock_t), and timers fire with a resolution of
+     * tickLength clocks (never before their expiry). Timers further than 64^4 ticks away are
+     * kept in the last level until they get closer.
+     */
+    class TimerWheel {
+        public:
+            typedef uint64_t TimerId;
+
+            static constexpr TimerId INVALID_TIMER = 0;
+            // Returned by getNextExpiry() when no timer is scheduled
+            static constexpr clock_t NEVER = UINT64_MAX;
+
+        private:
+            static constexpr int LEVELS = 4;
+            static constexpr int SLOT_BITS = 6;
+            static constexpr uint32_t SLOTS = 1 << SLOT_BITS;
+            static constexpr uint32_t NONE = UINT32_MAX;
+
+            struct Timer {
+                uint64_t expiryTick;
+                uint32_t tag;
+                // Increased each time the entry is reused, so stale TimerIds can be told apart
+                uint32_t generation;
+                // Doubly-linked list of the slot (next is also used for the list of free entries)
+                uint32_t previous;
+                uint32_t next;
+                uint32_t slot;
+                bool active;
+            };
+
+            std::vector<Timer> timers;
+            uint32_t freeTimers = NONE;
+            size_t activeTimers = 0;
+
+            // First timer of each slot (LEVELS * SLOTS) and one bit per slot with timers, per level
+            uint32_t slots[LEVELS * SLOTS];
+            uint64_t occupiedSlots[LEVELS];
+
+            clock_t tickLength = 1000;
+            uint64_t currentTick = 0;
+
+            static uint32_t slotIndex(int level, uint64_t tick) {
+                return (uint32_t)((tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+            }
+
+            void link(uint32_t index) {
+                Timer & timer = timers[index];
+                uint64_t delta = timer.expiryTick - currentTick;
+
+                int level = 0;
+                while (level < LEVELS - 1 && delta >= ((uint64_t)1 << (SLOT_BITS * (level + 1))))
+                    level++;
+
+                uint32_t slot;
+                if (delta >= ((uint64_t)1 << (SLOT_BITS * LEVELS))) {
+                    // Too far away: the last slot of the last level to be cascaded, where it will be linked again
+                    slot = (slotIndex(level, currentTick) + SLOTS - 1) & (SLOTS - 1);
+                } else {
+                    slot = slotIndex(level, timer.expiryTick);
+                }
+
+                timer.slot = level * SLOTS + slot;
+                timer.previous = NONE;
+                timer.next = slots[timer.slot];
+                if (timer.next != NONE)
+                    timers[timer.next].previous = index;
+                slots[timer.slot] = index;
+                occupiedSlots[level] |= (uint64_t)1 << slot;
+            }
+
+            void unlink(uint32_t index) {
+                Timer & timer = timers[index];
+                if (timer.previous != NONE)
+                    timers[timer.previous].next = timer.next;
+                else
+                    slots[timer.slot] = timer.next;
+                if (timer.next != NONE)
+                    timers[timer.next].previous = timer.previous;
+
+                if (slots[timer.slot] == NONE)
+                    occupiedSlots[timer.slot / SLOTS] &= ~((uint64_t)1 << (timer.slot % SLOTS));
+            }
+
+            void release(uint32_t index) {
+                Timer & timer = timers[index];
+                timer.active = false;
+                timer.generation++;
+                timer.next = freeTimers;
+                freeTimers = index;
+                activeTimers--;
+            }
+
+            /*
+             * Moves the timers of a slot of an upper level to the levels below.
+             */
+            void cascade(int level, uint32_t slot) {
+                uint32_t index = slots[level * SLOTS + slot];
+                slots[level * SLOTS + slot] = NONE;
+                occupiedSlots[level] &= ~((uint64_t)1 << slot);
+                while (index != NONE) {
+                    uint32_t next = timers[index].next;
+                    link(index);
+                    index = next;
+                }
+            }
+
+            /*
+             * First slot with timers of a level, looking from the one after the current
+             * one (the first to be reached) and ending with the current one (the last).
+             */
+            int firstOccupiedSlot(int level) const {
+                uint64_t occupied = occupiedSlots[level];
+                if (occupied == 0)
+                    return -1;
+                uint32_t start = (slotIndex(level, currentTick) + 1) & (SLOTS - 1);
+                uint64_t rotated = start == 0 ? occupied : (occupied >> start) | (occupied << (SLOTS - start));
+                return (start + __builtin_ctzll(rotated)) & (SLOTS - 1);
+            }
+
+            /*
+             * Next tick at which a slot with timers is reached: a slot of the first level fires
+             * its timers, and one of the upper levels is cascaded. UINT64_MAX if there are no timers.
+             */
+            uint64_t nextBusyTick() const {
+                uint64_t nextTick = UINT64_MAX;
+                for (int level = 0; level < LEVELS; level++) {
+                    int slot = firstOccupiedSlot(level);
+                    if (slot < 0)
+                        continue;
+                    uint32_t distance = (slot - slotIndex(level, currentTick)) & (SLOTS - 1);
+                    if (distance == 0)
+                        distance = SLOTS;
+                    uint64_t tick = ((currentTick >> (SLOT_BITS * level)) + distance) << (SLOT_BITS * level);
+                    if (tick < nextTick)
+                        nextTick = tick;
+                }
+                return nextTick;
+            }
+
+        public:
+            TimerWheel(clock_t tickLength = 1000, clock_t now = 0) {
+                reset(tickLength, now);
+            }
+
+            /*
+             * Cancels every timer and starts again at time now, with ticks of tickLength clocks.
+             */
+            void reset(clock_t tickLength, clock_t now) {
+                this->tickLength = tickLength > 0 ? tickLength : 1;
+                this->currentTick = now / this->tickLength;
+                timers.clear();
+                freeTimers = NONE;
+                activeTimers = 0;
+                for (uint32_t & slot : slots)
+                    slot = NONE;
+                for (uint64_t & occupied : occupiedSlots)
+                    occupied = 0;
+            }
+
+            /*
+             * Schedules a timer at the given time (if it is already due, it fires in the next
+             * tick). The tag is passed back when it fires.
+             */
+            TimerId schedule(clock_t expiry, uint32_t tag = 0) {
+                uint32_t index;
+                if (freeTimers != NONE) {
+                    index = freeTimers;
+                    freeTimers = timers[index].next;
+                } else {
+                    index = (uint32_t)timers.size();
+                    timers.push_back(Timer{});
+                }
+
+                Timer & timer = timers[index];
+                uint64_t expiryTick = (expiry + tickLength - 1) / tickLength;
+                timer.expiryTick = expiryTick > currentTick ? expiryTick : currentTick + 1;
+                timer.tag = tag;
+                timer.active = true;
+                activeTimers++;
+                link(index);
+
+                return ((TimerId)timer.generation << 32) | (index + 1);
+            }
+
+            /*
+             * Cancels a timer. Returns false if it already fired or was cancelled.
+             */
+            bool cancel(TimerId id) {
+                if (id == INVALID_TIMER)
+                    return false;
+                uint32_t index = (uint32_t)(id & 0xffffffff) - 1;
+                if (index >= timers.size() || !timers[index].active || timers[index].generation != (uint32_t)(id >> 32))
+                    return false;
+
+                unlink(index);
+                release(index);
+                return true;
+            }
+
+            /*
+             * Advances the time to now, calling onExpiry(id, tag) for each timer that expires, in
+             * order of expiry. onExpiry may schedule and cancel timers.
+             */
+            template <class Callback>
+            void advance(clock_t now, Callback onExpiry) {
+                uint64_t targetTick = now / tickLength;
+                while (currentTick < targetTick) {
+                    // Jump straight to the next tick with something to do (timers to fire or to cascade)
+                    uint64_t nextTick = nextBusyTick();
+                    if (nextTick > targetTick) {
+                        currentTick = targetTick;
+                        return;
+                    }
+
+                    currentTick = nextTick;
+                    for (int level = LEVELS - 1; level > 0; level--) {
+                        if ((currentTick & (((uint64_t)1 << (SLOT_BITS * level)) - 1)) == 0)
+                            cascade(level, slotIndex(level, currentTick));
+                    }
+
+                    uint32_t slot = slotIndex(0, currentTick);
+                    while (slots[slot] != NONE) {
+                        uint32_t index = slots[slot];
+                        unlink(index);
+                        TimerId id = ((TimerId)timers[index].generation << 32) | (index + 1);
+                        uint32_t tag = timers[index].tag;
+                        release(index);
+                        onExpiry(id, tag);
+                    }
+                }
+            }
+
+            /*
+             * Time at which the next timer fires (a multiple of tickLength), or NEVER if there are no timers.
+             */
+            clock_t getNextExpiry() const {
+                if (activeTimers == 0)
+                    return NEVER;
+
+                uint64_t nextTick = UINT64_MAX;
+                for (int level = 0; level < LEVELS; level++) {
+                    // The slots of the last level are not in order of expiry: the one where the timers further
+                    // than 64^4 ticks away wait may be reached before those with nearer timers, so all are checked
+                    uint64_t occupied = occupiedSlots[level];
+                    if (level < LEVELS - 1) {
+                        int slot = firstOccupiedSlot(level);
+                        occupied = slot < 0 ? 0 : (uint64_t)1 << slot;
+                    }
+                    for (; occupied != 0; occupied &= occupied - 1) {
+                        uint32_t slot = __builtin_ctzll(occupied);
+                        for (uint32_t index = slots[level * SLOTS + slot]; index != NONE; index = timers[index].next) {
+                            if (timers[index].expiryTick < nextTick)
+                                nextTick = timers[index].expiryTick;
+                        }
+                    }
+                }
+                return nextTick * tickLength;
+            }
+
+            size_t size() const {
+                return activeTimers;
+            }
+    };
+
+}
+
+#endif
@@ -31,37 +31,39 @@ void ButterflySimulation::initialize(){
     }
 
     setReportWhenMarked(true);
+    // The netlist only needs to be evaluated again when the inputs or the netlist change
+    setEventDriven(true);
 }
 
 // Prints the current gpio header states
 void ButterflySimulation::print_gpio_header_states(){
-    this->log() << "----- Input -----" << endl;
+    this->log(LabsLand::Utils::LogLevel::Debug) << "----- Input -----" << endl;
     for(int i = 0; i < this->getNumberOfSimulationInputs(); i++){
-        this->log() << "g" << i << ": " << this->input_gpio_tracker[i] << endl;
+        this->log(LabsLand::Utils::LogLevel::Debug) << "g" << i << ": " << this->input_gpio_tracker[i] << endl;
     }
 
-    this->log() << "----- Output -----" << endl;
+    this->log(LabsLand::Utils::LogLevel::Debug) << "----- Output -----" << endl;
     for(int i = 0; i < this->getNumberOfSimulationOutputs(); i++){
-        this->log() << "g" << i << ": " << this->output_gpio_tracker[i] << endl;
+        this->log(LabsLand::Utils::LogLevel::Debug) << "g" << i << ": " << this->output_gpio_tracker[i] << endl;
     }
 }
 
 // Prints the current buffer states
 void ButterflySimulation::print_buffer_states(){
-    this->log() << "buffer: ";
+    this->log(LabsLand::Utils::LogLevel::Debug) << "buffer: ";
     for(int i = 0; i < BUFFER_ARRAY_SIZE; i++){
-        this->log() << this->buffer[i] << " ";
+        this->log(LabsLand::Utils::LogLevel::Debug) << this->buffer[i] << " ";
     }
-    this->log() << endl;
+    this->log(LabsLand::Utils::LogLevel::Debug) << endl;
 }
 
 // Prints the current LED states
 void ButterflySimulation::print_led_states(){
-    this->log() << "virtual led: ";
+    this->log(LabsLand::Utils::LogLevel::Debug) << "virtual led: ";
     for(int i = 0; i < LED_ARRAY_SIZE; i++){
-        this->log() << mState.virtual_led[i] << " ";
+        this->log(LabsLand::Utils::LogLevel::Debug) << mState.virtual_led[i] << " ";
     }
-    this->log() << endl;
+    this->log(LabsLand::Utils::LogLevel::Debug) << endl;
 }
 
 // Converts LT or LF to a boolean True or False
@@ -319,18 +321,21 @@ void ButterflySimulation::update(double delta){
         return;
     }
 
-    this->log() << endl << "===== GPIO STATES =====" << endl;
-    print_gpio_header_states();
-    this->log() << endl << "===== BUFFER STATES =====" << endl;
-    print_buffer_states();
-    this->log() << endl << "===== LED STATES =====" << endl;
-    print_led_states();
-    this->log() << mState.serialize() << endl;
+    // Dumping the states is most of the cost of an update: only do it if it is going to be logged
+    if (this->isLogEnabled(LabsLand::Utils::LogLevel::Debug)) {
+        this->log(LabsLand::Utils::LogLevel::Debug) << endl << "===== GPIO STATES =====" << endl;
+        print_gpio_header_states();
+        this->log(LabsLand::Utils::LogLevel::Debug) << endl << "===== BUFFER STATES =====" << endl;
+        print_buffer_states();
+        this->log(LabsLand::Utils::LogLevel::Debug) << endl << "===== LED STATES =====" << endl;
+        print_led_states();
+        this->log(LabsLand::Utils::LogLevel::Debug) << mState.serialize() << endl;
+    }
 
-    this->log() << "===== STRING PROTOCOL =====" << endl;
+    LL_LOG(Debug) << "===== STRING PROTOCOL =====" << endl;
     while(index < my_string_length){
-        this->log() << "My string: " << my_string << endl;
-        this->log() << "Iter " << while_loop_counter << " : " << my_string.substr(index, my_string_length - index);
+        LL_LOG(Debug) << "My string: " << my_string << endl;
+        LL_LOG(Debug) << "Iter " << while_loop_counter << " : " << my_string.substr(index, my_string_length - index);
         while_loop_counter++;
         index += read_logic_gate(my_string.substr(index, my_string_length - index));
         if(my_string[index] == ';' || my_string[index] == '\n'){
@@ -341,13 +346,16 @@ void ButterflySimulation::update(double delta){
     index = 0;
     while_loop_counter = 1;
 
-    this->log() << endl << "===== GPIO STATES =====" << endl;
-    print_gpio_header_states();
-    this->log() << endl << "===== BUFFER STATES =====" << endl;
-    print_buffer_states();
-    this->log() << endl << "===== LED STATES =====" << endl;
-    print_led_states();
-    this->log() << mState.serialize() << endl;
+    // Dumping the states is most of the cost of an update: only do it if it is going to be logged
+    if (this->isLogEnabled(LabsLand::Utils::LogLevel::Debug)) {
+        this->log(LabsLand::Utils::LogLevel::Debug) << endl << "===== GPIO STATES =====" << endl;
+        print_gpio_header_states();
+        this->log(LabsLand::Utils::LogLevel::Debug) << endl << "===== BUFFER STATES =====" << endl;
+        print_buffer_states();
+        this->log(LabsLand::Utils::LogLevel::Debug) << endl << "===== LED STATES =====" << endl;
+        print_led_states();
+        this->log(LabsLand::Utils::LogLevel::Debug) << mState.serialize() << endl;
+    }
 
     requestReportState();
     // reportUpdate();
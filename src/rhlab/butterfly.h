@@ -44,16 +44,22 @@ struct ButterflyRequest : public BaseInputDataType {
 struct ButterflyData : public BaseOutputDataType {
     bool virtual_led[LED_ARRAY_SIZE];
 
+    static constexpr auto fields() {
+        using namespace LabsLand::Simulations::Utils;
+        return describeFields(field("led", &ButterflyData::virtual_led));
+    }
+
+    // "led0=<0|1>&led1=<0|1>&..."
     string serialize() const {
-        stringstream stream;
-        for(int i = 0; i < LED_ARRAY_SIZE; i++){
-            stream << "led" << i << "=" << virtual_led[i];
-            if(i < LED_ARRAY_SIZE - 1){
-                stream << "&";
-            }
-        }
+        return serializeToString();
+    }
+
+    size_t serializeTo(char * buffer, size_t size) const override {
+        return LabsLand::Simulations::Utils::writeQueryArgs(*this, buffer, size);
+    }
 
-        return stream.str();
+    size_t serializeBinary(char * buffer, size_t size) const override {
+        return LabsLand::Simulations::Utils::writeBinary(*this, buffer, size);
     }
 };
 
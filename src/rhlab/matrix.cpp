@@ -11,6 +11,8 @@ void MatrixSimulation::initialize(){
     this->targetDevice->initializeSimulation({}, {"latch", "pulse", "green", "red"});
 
     setReportWhenMarked(true);
+    // Report animations quickly while somebody is watching them
+    setReportRatePolicy(make_shared<LabsLand::Simulations::Utils::AdaptiveReportRatePolicy>());
 }
 
 bool MatrixSimulation::readSerialCommunication(vector<vector<bool>>& buffer, vector<string>& gpios) {
@@ -22,7 +24,7 @@ bool MatrixSimulation::readSerialCommunication(vector<vector<bool>>& buffer, vec
             // Read the data bit when the pulse is high
             for (int j = 0; j < buffer[i].size(); j++) {
                 buffer[i][j] = this->targetDevice->getGpio(gpios[j]);
-                this->log() << "buffer[" << i << "][ " << j << "] = " << ((buffer[i][j] == true)?"1":"0") << "; // " << gpios[j] << endl;
+                LL_LOG(Trace) << "buffer[" << i << "][ " << j << "] = " << ((buffer[i][j] == true)?"1":"0") << "; // " << gpios[j] << endl;
             }
             // Wait for the pulse to go low again before reading the next bit
             while (this->targetDevice->getGpio("pulse") == 1) {}
@@ -71,7 +73,7 @@ void MatrixSimulation::update(double delta) {
                 this->mState.setLed(row, col, color);
             }
         }
-        this->log() << "Reporting:" << this->mState.serialize() << endl;
+        LL_LOG(Debug) << "Reporting:" << this->mState.serialize() << endl;
         requestReportState();
     }
 }
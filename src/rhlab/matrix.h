@@ -48,19 +48,29 @@ namespace RHLab::LEDMatrix {
                 leds[row * COLS + col] = color;
             }
 
+            static constexpr auto fields() {
+                using namespace LabsLand::Simulations::Utils;
+                return describeFields(field("leds", &MatrixData::leds));
+            }
+
+            // One row after the other, separated by ':'
             string serialize() const {
-                stringstream stream;
+                return serializeToString();
+            }
 
+            size_t serializeTo(char * buffer, size_t size) const override {
+                LabsLand::Simulations::Utils::FixedBufferWriter writer(buffer, size);
                 for (int row = 0; row < ROWS; row++) {
-                    for (int col = 0; col < COLS; col++){
-                        stream << leds[row * COLS + col];
-                    }
+                    writer.append(leds + row * COLS, COLS);
                     if(row < ROWS - 1){
-                        stream << ":";
+                        writer.append(':');
                     }
                 }
+                return writer.getLength();
+            }
 
-                return stream.str();
+            size_t serializeBinary(char * buffer, size_t size) const override {
+                return LabsLand::Simulations::Utils::writeBinary(*this, buffer, size);
             }
     };
 
@@ -70,6 +80,11 @@ namespace RHLab::LEDMatrix {
             void update(double delta) override;
             bool readSerialCommunication(vector<vector<bool>>& buffer, vector<string>& gpios);
             void initialize() override;
+
+            // The LEDs are clocked in serially, so update at 1 kHz
+            uint32_t getSleepStepInUs() override {
+                return 1000;
+            }
     };
 }
 
@@ -75,13 +75,13 @@ void MorseSimulation::initializeMorseDictionary() {
 }
 
 void MorseSimulation::translateMorse(char symbol) {
-    this->log() << "Translating symbol: " << symbol << endl;
+    LL_LOG(Debug) << "Translating symbol: " << symbol << endl;
     
     // Process according to the symbol
     if (symbol == '.' || symbol == '-') {
         // Add to current sequence
         currentSequence += symbol;
-        this->log() << "Current sequence: " << currentSequence << endl;
+        LL_LOG(Debug) << "Current sequence: " << currentSequence << endl;
     }
     else if (symbol == '/') {
         // Letter space - translate the current sequence
@@ -129,6 +129,8 @@ void MorseSimulation::translateMorse(char symbol) {
 void MorseSimulation::initialize(){
     this->targetDevice->initializeSimulation({}, {"morseSignal"});
     setReportWhenMarked(true);
+    // Speed changes and clears are handled in onRequest() as soon as they arrive
+    setDispatchRequests(true);
 
     // Initialize default speed thresholds
     updateSpeedThresholds('N'); // Default to normal speed
@@ -166,7 +168,7 @@ void MorseSimulation::updateSpeedThresholds(char speed) {
 
 // Interpret the signal based on its duration
 void MorseSimulation::interpretSignal(bool isHigh, double duration) {
-    this->log() << "Interpreting signal: " << (isHigh ? "HIGH" : "LOW") << " with duration " << duration << " s" << endl;
+    LL_LOG(Debug) << "Interpreting signal: " << (isHigh ? "HIGH" : "LOW") << " with duration " << duration << " s" << endl;
     
     if (isHigh) {
         // Signal was high (mark)
@@ -189,39 +191,32 @@ void MorseSimulation::interpretSignal(bool isHigh, double duration) {
     }
 }
 
-void MorseSimulation::update(double delta) {
-    MorseRequest userRequest;
-    bool requestWasRead = readRequest(userRequest);
-    if(requestWasRead) {
-        this->log() << "Updating speed to: " << userRequest.speed << " clearing: " << userRequest.clearing << endl;;
-        
-        // Update speed thresholds when speed changes
-        updateSpeedThresholds(userRequest.speed);
+void MorseSimulation::onRequest(const MorseRequest & userRequest) {
+    this->log() << "Updating speed to: " << userRequest.speed << " clearing: " << userRequest.clearing << endl;;
 
-        // do something with speed or clearing
-        if (userRequest.clearing) {
-            this->mState.clearBuffer();
-            this->currentSequence = ""; // Clear current sequence
-            this->log() << "Clearing buffer" << endl;
+    // Update speed thresholds when speed changes
+    updateSpeedThresholds(userRequest.speed);
 
-            // Request state report to update the UI
-            requestReportState();
-        }
+    // do something with speed or clearing
+    if (userRequest.clearing) {
+        this->mState.clearBuffer();
+        this->currentSequence = ""; // Clear current sequence
+        this->log() << "Clearing buffer" << endl;
+
+        // Request state report to update the UI
+        requestReportState();
     }
+}
 
+void MorseSimulation::update(double delta) {
     // Get current signal state
     bool currentSignal = this->targetDevice->getGpio("morseSignal");
     
     // Log the current state
-    this->log() << "Checking morseSignal " << delta << " " << currentSignal << endl;
-    
-    // Static variables to persist between calls
-    static bool lastSignal = currentSignal;  // Initialize with current value
-    static clock_t lastTransitionTime = this->timeManager->getAbsoluteTime();
-    static bool initialized = false;
+    LL_LOG(Debug) << "Checking morseSignal " << delta << " " << currentSignal << endl;
     
     // Get current timestamp
-    clock_t currentTime = this->timeManager->getAbsoluteTime();
+    LabsLand::Utils::clock_t currentTime = this->timeManager->getAbsoluteTime();
     
     // First-time initialization
     if (!initialized) {
@@ -102,14 +102,18 @@ namespace RHLab::Morse {
                 translatedText[lastTextPos + 1] = '\0';
             }
 
+            // Combine the Morse buffer and translated text into a JSON object: {"morse":"...","text":"..."}
             string serialize() const {
-                // Combine the Morse buffer and translated text into a JSON-like format
-                string result = "{\"morse\":\"";
-                result += buffer;
-                result += "\",\"text\":\"";
-                result += translatedText;
-                result += "\"}";
-                return result;
+                return serializeToString();
+            }
+
+            size_t serializeTo(char * output, size_t size) const override {
+                LabsLand::Simulations::Utils::JsonWriter json(output, size);
+                json.beginObject()
+                        .field("morse", std::string_view(buffer, strnlen(buffer, BUFFER_SIZE)))
+                        .field("text", std::string_view(translatedText, strnlen(translatedText, TEXT_BUFFER_SIZE)))
+                    .endObject();
+                return json.getLength();
             }
     };
 
@@ -127,6 +131,11 @@ namespace RHLab::Morse {
             
             // Current morse sequence being built
             std::string currentSequence;
+
+            // Signal tracking, initialized in the first update() (members, so several instances can run at once)
+            bool lastSignal = false;
+            LabsLand::Utils::clock_t lastTransitionTime = 0;
+            bool initialized = false;
             
             // Process morse code and update translated text
             void translateMorse(char symbol);
@@ -137,6 +146,7 @@ namespace RHLab::Morse {
         public:
             MorseSimulation();
             void update(double delta) override;
+            void onRequest(const MorseRequest & userRequest) override;
             void initialize() override;
             void interpretSignal(bool isHigh, double duration);
             void updateSpeedThresholds(char speed);